@@ -18,6 +18,14 @@
  * Atari.cpp: file which handles all reads and writes to the Atari 2600's RAM
  * as well as system clocking.
  *
+ * The 6507 only drives 13 address lines, so the map below repeats every 8KB (the cartridge is
+ * usually addressed at 0xF000). Within it, A12 selects the cartridge; otherwise A7 clear selects
+ * the TIA, and A7 set selects the RIOT's RAM or, with A9 set, its I/O ports and timer. Each of
+ * these chips decodes only some of the remaining lines, so its registers are mirrored all over
+ * its range (e.g. the RAM at 0x80 also appears at 0x180, where the stack lives). The map is a
+ * table of 128-byte pages: RAM and ROM are read and written through pointers into their storage,
+ * and only the TIA and RIOT registers (and writes to the cartridge) go through handlers.
+ *
  * Atari 2600 Memory Map:
  *
  * 0xFFFF -----------> +------------------------------+   --+
@@ -131,35 +139,214 @@
  * 0296    TIM64T  11111111  set 64 clock interval (53.6 usec/interval)
  * 0297    T1024T  11111111  set 1024 clock interval (858.2 usec/interval)
  */
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <type_traits>
+
 #include "Atari.hpp"
 
+static_assert(std::is_trivially_copyable<Atari::State>::value, "states are copied as bytes");
+
+/**
+ * What a saved state starts with, followed by the Atari::State itself. Saved states are only
+ * loaded by the same build of the emulator on the same machine, so the layout of both is kept as
+ * the compiler lays them out.
+ */
+struct StateHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t size;
+    uint64_t romHash;
+};
+
 Atari::Atari() {
     m_cpu.connectAtari(this);
     m_tia.connectAtari(this);
+    m_jit.connectAtari(this);
+    m_plugin.connectAtari(this);
+    mapPages();
 }
 
 Atari::~Atari() = default;
 
+/**
+ * @brief Read the controllers and console switches from the given source from now on (see
+ * pollInputs()), none if it's null.
+ */
+void Atari::connectInput(InputSource* input) {
+    m_input = input;
+}
+
 /**
  * @brief Reset all registers and object fields to their appropriate initial values
  */
 void Atari::reset() {
     m_cpu.reset();
     m_tia.reset();
+    m_jit.flush();
 }
 
 /**
- * @brief Perform one system step. Since the TIA's clock frequency is three times that of the
- * CPU's, one CPU step is performed for every three TIA steps.
+ * Latch the current state of the connected input source into the registers the game reads it
+ * from. The fire buttons go straight into the TIA's input registers, which the CPU can't write.
+ * Without a source, the registers keep whatever they were last set to.
+ */
+void Atari::pollInputs() {
+    if (!m_input) {
+        return;
+    }
+
+    InputSource::Inputs inputs = m_input->poll();
+    write8(SWCHA, inputs.joysticks);
+    write8(SWCHB, inputs.switches);
+    m_tia.m_regs[INPT4] = inputs.button0;
+    m_tia.m_regs[INPT5] = inputs.button1;
+}
+
+/**
+ * @brief Perform one system step: execute one whole CPU instruction. The TIA is not stepped
+ * alongside the CPU; instead it falls behind and is caught up in one batch whenever the CPU reads
+ * one of its registers (see sync()); writes to the TIA are queued up for it instead (see
+ * writeTia()). The timer isn't run at all (see Timer). Since the TIA's clock frequency is three
+ * times that of the CPU's, the TIA owes three color clocks for every CPU cycle. The CPU is never
+ * allowed to run so far ahead that the TIA could complete a frame while catching up; when it gets
+ * close, the TIA is caught up here and the step ends early if a frame completes. When the ROM has
+ * been recompiled (see Plugin) or the JIT is enabled, a whole block is executed instead of a
+ * single instruction if it fits.
  */
 void Atari::step() {
-    m_tia.step();
+    uint64_t target = 3 * m_cycles + 1;
+
+    if (target - m_tia.m_clocks >= m_tia.clocksUntilFrameDone()) {
+        m_tia.run(target - m_tia.m_clocks);
+
+        if (m_tia.m_frameDone) {
+            return;
+        }
+    }
+
+    // Every instruction executed from here has to start before the TIA would complete the frame
+    uint32_t budget = (m_tia.clocksUntilFrameDone() - (target - m_tia.m_clocks) - 1) / 3;
+
+    if (m_plugin.m_loaded || m_jit.m_enabled) {
+        uint32_t cycles = m_plugin.run(budget);
+
+        if (!cycles && m_jit.m_enabled) {
+            cycles = m_jit.run(budget);
+        }
+
+        if (cycles) {
+            m_cycles += cycles;
+            return;
+        }
+    }
 
-    if (m_clocks % 3 == 0) {
-        m_cpu.step();
+    m_cycles += m_cpu.step(budget);
+}
+
+/**
+ * Snapshot the machine between two steps. The TIA is caught up with the CPU first, so that it has
+ * next to no register writes queued up.
+ * @return false if the TIA's queued writes didn't fit in the snapshot
+ */
+bool Atari::save(State& state) {
+    sync();
+
+    // Zeroed first so that snapshots of the same state compare equal byte for byte
+    std::memset(&state, 0, sizeof(state));
+    state.cycles = m_cycles;
+    state.ram = m_ram;
+    state.riotRegs = m_riotRegs;
+    m_cpu.save(state.cpu);
+    m_timer.save(state.timer);
+    return m_tia.save(state.tia);
+}
+
+/**
+ * @brief Restore a snapshot taken by save(), with the same cartridge inserted.
+ */
+void Atari::load(const State& state) {
+    m_cycles = state.cycles;
+    m_ram = state.ram;
+    m_riotRegs = state.riotRegs;
+    m_cpu.load(state.cpu);
+    m_timer.load(state.timer);
+    m_tia.load(state.tia);
+}
+
+/**
+ * @brief Write a snapshot of the machine (see save()) to the given stream, tagged with its
+ * version and the cartridge it belongs to.
+ * @return true if the state was written
+ */
+bool Atari::saveState(std::ostream& out) {
+    State state;
+    if (!save(state)) {
+        return false;
     }
 
-    m_clocks++;
+    StateHeader header = { STATE_MAGIC, STATE_VERSION, sizeof(State),
+        Plugin::romHash(m_rom.data()) };
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(&state), sizeof(state));
+    return static_cast<bool>(out);
+}
+
+/**
+ * Read a snapshot written by saveState() and restore it. States of another version or another
+ * cartridge are refused, leaving the machine as it was.
+ * @return true if the state was loaded
+ */
+bool Atari::loadState(std::istream& in) {
+    StateHeader header;
+    State state;
+
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header))
+            || header.magic != STATE_MAGIC || header.version != STATE_VERSION
+            || header.size != sizeof(State) || header.romHash != Plugin::romHash(m_rom.data())
+            || !in.read(reinterpret_cast<char*>(&state), sizeof(state))) {
+        return false;
+    }
+
+    load(state);
+    return true;
+}
+
+/**
+ * Catch the TIA up to the current CPU cycle so that the CPU can read its registers. On the CPU's
+ * cycle n, the TIA has run its color clocks 0 through 3n, whatever n. The original
+ * clock-by-clock loop counted color clocks in 16 bits, and since 65536 isn't a multiple of 3,
+ * every wrap of the counter gave the CPU an extra cycle; games drift differently from then on, so
+ * frames only match that loop's up to its first wrap, two to three frames in.
+ */
+void Atari::sync() {
+    uint64_t target = 3 * (m_cycles + m_cpu.m_elapsed) + 1;
+
+    while (m_tia.m_clocks < target) {
+        m_tia.run(target - m_tia.m_clocks);
+    }
+}
+
+/**
+ * @brief Fill in the page table according to the chip selects described at the top of the file.
+ */
+void Atari::mapPages() {
+    for (uint16_t i = 0; i < PAGE_COUNT; i++) {
+        uint16_t addr = i << PAGE_BITS;
+        Page& page = m_pages[i];
+
+        page = Page{ nullptr, nullptr, &Atari::readTia, &Atari::writeTia };
+        if (isCart(addr)) {
+            page.read = m_rom.data() + (addr & (SIZE_CART - SIZE_PAGE));
+            page.writeDevice = &Atari::writeCart;
+        } else if (isRam(addr)) {
+            page.read = page.write = m_ram.data();
+        } else if (addr & 0x80) {
+            page.readDevice = &Atari::readRiot;
+            page.writeDevice = &Atari::writeRiot;
+        }
+    }
 }
 
 /**
@@ -167,7 +354,14 @@ void Atari::step() {
  * @return Unsigned 8-bit value at given address
  */
 uint8_t Atari::read8(uint16_t addr) {
-    return m_ram[addr];
+    addr &= ADDR_MASK;
+
+    const Page& page = m_pages[addr >> PAGE_BITS];
+    if (page.read) {
+        return page.read[addr & (SIZE_PAGE - 1)];
+    }
+
+    return (this->*page.readDevice)(addr);
 }
 
 /*
@@ -181,43 +375,126 @@ uint16_t Atari::read16(uint16_t addr) {
 }
 
 /*
- * @brief Write the given byte at the given address. If a strobe register is written to, its
- * respective boolean will be set to true and the value will be stored at the given address.
+ * @brief Write the given byte at the given address.
  */
 void Atari::write8(uint16_t addr, uint8_t data) {
-    m_ram[addr] = data;
+    addr &= ADDR_MASK;
 
+    const Page& page = m_pages[addr >> PAGE_BITS];
+    if (page.write) {
+        page.write[addr & (SIZE_PAGE - 1)] = data;
+    } else {
+        (this->*page.writeDevice)(addr, data);
+    }
+}
+
+/**
+ * The TIA only decodes A0-A3 on reads, so its read registers (the collision latches and inputs,
+ * kept at 30-3D) show up at 00-0D and are mirrored every 16 bytes.
+ */
+uint8_t Atari::readTia(uint16_t addr) {
+    sync();
+    return m_tia.m_regs[0x30 | (addr & 0x0F)];
+}
+
+/**
+ * Hand a write to a TIA register to the TIA, stamped with the color clock it happens on. The TIA
+ * applies it when it gets there, so the TIA doesn't have to be caught up for it. A write asserting
+ * VSYNC ends the frame on its clock, which bounds how far the CPU may run ahead from then on (see
+ * TIA::clocksUntilFrameDone()). WSYNC isn't a TIA register as such but halts the CPU.
+ */
+void Atari::writeTia(uint16_t addr, uint8_t data) {
+    addr &= 0x3F;
     if (addr == WSYNC) {
-        m_wsync = 1;
-    } else if (addr == RESP0) {
-        m_resp0 = 1;
-    } else if (addr == RESP1) {
-        m_resp1 = 1;
-    } else if (addr == RESM0) {
-        m_resm0 = 1;
-    } else if (addr == RESM1) {
-        m_resm1 = 1;
-    } else if (addr == RESBL) {
-        m_resbl = 1;
-    } else if (addr == HMOVE) {
-        m_hmove = 1;
-    } else if (addr == HMCLR) {
-        m_hmclr = 1;
-    } else if (addr == CXCLR) {
-        for (int i = 0x30; i < 0x38; i++) {
-            write8(i, 0x00);
-        }
-    } else if (addr == TIM1T) {
-        m_tim1t = 1;
-    } else if (addr == TIM8T) {
-        m_tim8t = 1;
-    } else if (addr == TIM64T) {
-        m_tim64t = 1;
-    } else if (addr == T1024T) {
-        m_t1024t = 1;
+        haltUntilLineEnd();
+        return;
+    }
+
+    m_tia.write(3 * (m_cycles + m_cpu.m_elapsed) + 1, addr, data);
+}
+
+/**
+ * Halt the CPU on a write to WSYNC until the beam reaches the start of the next line, where the
+ * TIA releases RDY. The TIA is caught up to the write to find out where the beam is; the stall is
+ * then added to the step's cycles, so that the next instruction starts (and its writes land) on
+ * the line's first color clock. Neither the TIA nor the timer have anything to do for it: the TIA
+ * catches up on the whole stall in one batch with the next step, and the timer is only ever
+ * computed from the cycle it's read on.
+ */
+void Atari::haltUntilLineEnd() {
+    sync();
+
+    uint64_t lineStart = m_tia.m_clocks + m_tia.clocksUntilLineEnd();
+    uint64_t resume = (lineStart + 1) / 3;
+    uint64_t end = m_cycles + m_cpu.instructionEnd();
+
+    if (resume > end) {
+        m_cpu.m_cycles += resume - end;
     }
 }
 
+/**
+ * @brief Read a RIOT register. The timer's are worked out for the current cycle, so nothing has
+ * to be caught up for them.
+ */
+uint8_t Atari::readRiot(uint16_t addr) {
+    uint64_t cycle = m_cycles + m_cpu.m_elapsed;
+
+    switch (addr & RIOT_MASK) {
+        case INTIM & RIOT_MASK:
+            return m_timer.readIntim(cycle);
+        case INSTAT & RIOT_MASK:
+            return (m_riotRegs[INSTAT & RIOT_MASK] & 0x3F)
+                | (m_timer.underflowed(cycle) ? 0xC0 : 0x00);
+        default:
+            return m_riotRegs[addr & RIOT_MASK];
+    }
+}
+
+/**
+ * @brief Write a RIOT register through its handler (see riotWrites()).
+ */
+void Atari::writeRiot(uint16_t addr, uint8_t data) {
+    addr &= RIOT_MASK;
+    (this->*s_riotWrites[addr])(addr, data);
+}
+
+void Atari::storeRiot(uint8_t reg, uint8_t data) {
+    m_riotRegs[reg] = data;
+}
+
+/**
+ * @brief Write one of the timer intervals (1 << Shift cycles), which restarts the timer.
+ */
+template <uint8_t Shift>
+void Atari::startTimer(uint8_t reg, uint8_t data) {
+    m_riotRegs[reg] = data;
+    m_timer.write(m_cycles + m_cpu.m_elapsed, data, Shift);
+}
+
+constexpr std::array<Atari::RegisterWrite, RIOT_MASK + 1> Atari::riotWrites() {
+    std::array<RegisterWrite, RIOT_MASK + 1> table = {};
+
+    for (RegisterWrite& write : table) {
+        write = &Atari::storeRiot;
+    }
+
+    table[TIM1T & RIOT_MASK] = &Atari::startTimer<0>;
+    table[TIM8T & RIOT_MASK] = &Atari::startTimer<3>;
+    table[TIM64T & RIOT_MASK] = &Atari::startTimer<6>;
+    table[T1024T & RIOT_MASK] = &Atari::startTimer<10>;
+    return table;
+}
+
+const std::array<Atari::RegisterWrite, RIOT_MASK + 1> Atari::s_riotWrites = riotWrites();
+
+/**
+ * @brief Writes to the ROM are ignored. Bank switching cartridges would switch banks here, after
+ * which the CPU's decode cache, the JIT and any plugin have to be flushed.
+ */
+void Atari::writeCart(uint16_t, uint8_t) {
+}
+
 /**
  * @brief Write a 16-bit value at the given address in little endian format.
  */
@@ -1,9 +1,14 @@
 #pragma once
 
 #include <cstdint>
+#include <iosfwd>
 
 #include "CPU.hpp"
+#include "InputSource.hpp"
+#include "JIT.hpp"
+#include "Plugin.hpp"
 #include "TIA.hpp"
+#include "Timer.hpp"
 
 #define VSYNC  0x00
 #define VBLANK 0x01
@@ -25,6 +30,12 @@
 #define RESM0  0x12
 #define RESM1  0x13
 #define RESBL  0x14
+#define AUDC0  0x15
+#define AUDC1  0x16
+#define AUDF0  0x17
+#define AUDF1  0x18
+#define AUDV0  0x19
+#define AUDV1  0x1A
 #define GRP0   0x1B
 #define GRP1   0x1C
 #define ENAM0  0x1D
@@ -38,6 +49,14 @@
 #define HMOVE  0x2A
 #define HMCLR  0x2B
 #define CXCLR  0x2C
+#define CXM0P  0x30
+#define CXM1P  0x31
+#define CXP0FB 0x32
+#define CXP1FB 0x33
+#define CXM0FB 0x34
+#define CXM1FB 0x35
+#define CXBLPF 0x36
+#define CXPPMM 0x37
 #define INPT4  0x3C
 #define INPT5  0x3D
 
@@ -50,39 +69,136 @@
 #define TIM64T 0x296
 #define T1024T 0x297
 
-#define SIZE_RAM 0x10000
+// Registers of the RIOT's I/O page are decoded by its low address bits only
+#define RIOT_MASK 0x1F
+
+// The 6507 only has 13 address lines, so everything is mirrored every 8KB
+#define ADDR_MASK 0x1FFF
+
+// Size of the RIOT's RAM and of the pages the memory map is made of. A page is the smallest unit
+// the chip selects of the TIA, RIOT and cartridge decode.
+#define SIZE_RAM 0x80
+#define PAGE_BITS 7
+#define SIZE_PAGE (1 << PAGE_BITS)
+#define PAGE_COUNT ((ADDR_MASK + 1) >> PAGE_BITS)
+
+// Saved states start with STATE_MAGIC ("A26S") and the STATE_VERSION of their layout, which is
+// bumped whenever Atari::State or any of the states it's made of changes
+#define STATE_MAGIC 0x53363241
+#define STATE_VERSION 2
 
 class Atari {
 public:
+    /**
+     * The whole state of the machine between two steps, as a plain struct of a few hundred bytes
+     * which can be copied around freely. The cartridge ROM and the screen aren't part of it.
+     */
+    struct State {
+        uint64_t cycles;
+        CPU::State cpu;
+        Timer::State timer;
+        TIA::State tia;
+        std::array<uint8_t, SIZE_RAM> ram;
+        std::array<uint8_t, RIOT_MASK + 1> riotRegs;
+    };
+
     Atari();
     ~Atari();
 
+    void connectInput(InputSource* input);
     void reset();
+    void pollInputs();
     void step();
+    void sync();
+    bool save(State& state);
+    void load(const State& state);
+    bool saveState(std::ostream& out);
+    bool loadState(std::istream& in);
     uint8_t read8(uint16_t addr);
     uint16_t read16(uint16_t addr);
     void write8(uint16_t addr, uint8_t data);
     void write16(uint16_t addr, uint16_t data);
 
+    /**
+     * @brief Whether the given address selects the RIOT's RAM.
+     */
+    static constexpr bool isRam(uint16_t addr) {
+        return (addr & 0x1280) == 0x0080;
+    }
+
+    /**
+     * @brief Whether the given address selects the cartridge.
+     */
+    static constexpr bool isCart(uint16_t addr) {
+        return addr & 0x1000;
+    }
+
+    /**
+     * @brief Whether reading the given address reads INTIM, i.e. it selects the RIOT's I/O ports
+     * and timer and decodes to INTIM or one of its mirrors.
+     */
+    static constexpr bool isIntim(uint16_t addr) {
+        return (addr & 0x1280) == 0x0280 && (addr & RIOT_MASK) == (INTIM & RIOT_MASK);
+    }
+
+    /**
+     * @brief Whether accessing the given address goes straight to memory, without any device
+     * (and therefore without the TIA having to be caught up first).
+     */
+    static constexpr bool isMemory(uint16_t addr, bool write) {
+        return isRam(addr) || (isCart(addr) && !write);
+    }
+
     TIA m_tia;
     CPU m_cpu;
-    std::array<uint8_t, SIZE_RAM> m_ram;
-
-    // Strobe registers
-    uint8_t m_wsync = 0;
-    uint8_t m_resp0 = 0;
-    uint8_t m_resp1 = 0;
-    uint8_t m_resm0 = 0;
-    uint8_t m_resm1 = 0;
-    uint8_t m_resbl = 0;
-    uint8_t m_hmove = 0;
-    uint8_t m_hmclr = 0;
-    uint8_t m_tim1t = 0;
-    uint8_t m_tim8t = 0;
-    uint8_t m_tim64t = 0;
-    uint8_t m_t1024t = 0;
+    Timer m_timer;
+    JIT m_jit;
+    Plugin m_plugin;
+
+    // Memory and registers behind the memory map (the TIA keeps its own registers). RIOT
+    // registers are indexed by their address & RIOT_MASK; INTIM and INSTAT's flags are read from
+    // the timer instead.
+    std::array<uint8_t, SIZE_RAM> m_ram = {};
+    std::array<uint8_t, SIZE_CART> m_rom = {};
+    std::array<uint8_t, RIOT_MASK + 1> m_riotRegs = {};
+
+    // CPU cycles elapsed since power on
+    uint64_t m_cycles = 0;
 
 private:
-    uint16_t m_clocks = 0;
+    typedef uint8_t (Atari::*ReadHandler)(uint16_t addr);
+    typedef void (Atari::*WriteHandler)(uint16_t addr, uint8_t data);
+    typedef void (Atari::*RegisterWrite)(uint8_t reg, uint8_t data);
+
+    /**
+     * One page of the memory map. Plain memory is accessed through the pointers to the page's
+     * bytes; where a pointer is null, the access is a device register which goes to the handler.
+     */
+    struct Page {
+        uint8_t* read;
+        uint8_t* write;
+        ReadHandler readDevice;
+        WriteHandler writeDevice;
+    };
+
+    void mapPages();
+    uint8_t readTia(uint16_t addr);
+    void writeTia(uint16_t addr, uint8_t data);
+    void haltUntilLineEnd();
+    uint8_t readRiot(uint16_t addr);
+    void writeRiot(uint16_t addr, uint8_t data);
+    void writeCart(uint16_t addr, uint8_t data);
+
+    void storeRiot(uint8_t reg, uint8_t data);
+    template <uint8_t Shift> void startTimer(uint8_t reg, uint8_t data);
+    static constexpr std::array<RegisterWrite, RIOT_MASK + 1> riotWrites();
+
+    // Handlers of the writes to each RIOT register, indexed like the register file
+    static const std::array<RegisterWrite, RIOT_MASK + 1> s_riotWrites;
+
+    std::array<Page, PAGE_COUNT> m_pages;
+
+    // Where pollInputs() reads the controllers from, if anywhere
+    InputSource* m_input = nullptr;
 };
 
@@ -69,16 +69,27 @@
 #include <string>
 
 #include "Atari.hpp"
+#include "NullAudioDevice.hpp"
+#include "Pacer.hpp"
+#include "Resampler.hpp"
+#include "WavSink.hpp"
+
+// Sample rate the sound is output at
+#define OUTPUT_RATE 48000
+
+// Most frames run per redraw of the window when the emulation has fallen behind, so that it stays
+// responsive while catching up
+#define MAX_FRAMES_PER_UPDATE 4
 
 #define OLC_PGE_APPLICATION
 #include "olcPixelGameEngine.h"
 
-#define SIZE_CART 4096
-#define CART_OFFSET 0xF000
-
-class Atari2600Emulator : public olc::PixelGameEngine {
+class Atari2600Emulator : public olc::PixelGameEngine, public VideoSink, public InputSource {
 public:
-    Atari2600Emulator(const std::string& romPath) : m_romPath{romPath} {
+    Atari2600Emulator(const std::string& romPath, bool jit, const std::string& pluginPath,
+            const std::string& wavPath, bool mute)
+            : m_romPath{romPath}, m_jit{jit}, m_pluginPath{pluginPath}, m_wavPath{wavPath},
+              m_mute{mute} {
         sAppName = "Atari 2600 Emulator";
     }
 
@@ -88,9 +99,23 @@ private:
         ifs.open(m_romPath, std::ifstream::binary);
 
         if (ifs.is_open()) {
-            ifs.read((char*) m_atari.m_ram.data() + CART_OFFSET, SIZE_CART);
+            ifs.read((char*) m_atari.m_rom.data(), SIZE_CART);
             ifs.close();
             m_atari.reset();
+            m_atari.connectInput(this);
+            m_atari.m_tia.connectVideo(this);
+            m_atari.m_jit.setEnabled(m_jit);
+            if (!m_pluginPath.empty() && m_atari.m_plugin.load(m_pluginPath)) {
+                std::cout << "Running recompiled ROM from " << m_pluginPath << std::endl;
+            }
+            if (!m_wavPath.empty() && !m_wav.open(m_wavPath, OUTPUT_RATE)) {
+                std::cout << "Error creating " << m_wavPath << std::endl;
+            }
+            m_resampler.configure(AUDIO_RATE, OUTPUT_RATE, Resampler::Quality::HIGH);
+            if (!m_mute) {
+                m_device.open(OUTPUT_RATE);
+            }
+            m_pacer.reset(emulatedTime());
             return true;
         }
 
@@ -98,34 +123,56 @@ private:
         return false;
     }
 
-    bool OnUserUpdate(float elapsedTime) override {
-        uint8_t joysticks = 0x00;
-        uint8_t switches = 0x00;
-        uint8_t button1 = 0x00;
-        uint8_t button2 = 0x00;
-
-        joysticks |= GetKey(olc::Key::W).bHeld ? 0x00 : 0x10;
-        joysticks |= GetKey(olc::Key::S).bHeld ? 0x00 : 0x20;
-        joysticks |= GetKey(olc::Key::A).bHeld ? 0x00 : 0x40;
-        joysticks |= GetKey(olc::Key::D).bHeld ? 0x00 : 0x80;
-        joysticks |= GetKey(olc::Key::I).bHeld ? 0x00 : 0x01;
-        joysticks |= GetKey(olc::Key::K).bHeld ? 0x00 : 0x02;
-        joysticks |= GetKey(olc::Key::J).bHeld ? 0x00 : 0x04;
-        joysticks |= GetKey(olc::Key::L).bHeld ? 0x00 : 0x08;
-
-        switches |= GetKey(olc::Key::F1).bHeld ? 0x00 : 0x01;
-        switches |= GetKey(olc::Key::F2).bHeld ? 0x00 : 0x02;
-        switches |= GetKey(olc::Key::F3).bHeld ? 0x00 : 0x08;
-        switches |= GetKey(olc::Key::F4).bHeld ? 0x00 : 0x40;
-        switches |= GetKey(olc::Key::F5).bHeld ? 0x00 : 0x80;
-
-        button1 |= GetKey(olc::Key::C).bHeld ? 0x00 : 0x80;
-        button2 |= GetKey(olc::Key::M).bHeld ? 0x00 : 0x80;
-
-        m_atari.write8(SWCHA, joysticks);
-        m_atari.write8(SWCHB, switches);
-        m_atari.write8(INPT4, button1);
-        m_atari.write8(INPT5, button2);
+    /**
+     * @brief The controllers and console switches, from the keyboard.
+     */
+    Inputs poll() override {
+        Inputs inputs;
+        inputs.joysticks = 0x00;
+        inputs.switches = 0x00;
+        inputs.button0 = 0x00;
+        inputs.button1 = 0x00;
+
+        inputs.joysticks |= GetKey(olc::Key::W).bHeld ? 0x00 : 0x10;
+        inputs.joysticks |= GetKey(olc::Key::S).bHeld ? 0x00 : 0x20;
+        inputs.joysticks |= GetKey(olc::Key::A).bHeld ? 0x00 : 0x40;
+        inputs.joysticks |= GetKey(olc::Key::D).bHeld ? 0x00 : 0x80;
+        inputs.joysticks |= GetKey(olc::Key::I).bHeld ? 0x00 : 0x01;
+        inputs.joysticks |= GetKey(olc::Key::K).bHeld ? 0x00 : 0x02;
+        inputs.joysticks |= GetKey(olc::Key::J).bHeld ? 0x00 : 0x04;
+        inputs.joysticks |= GetKey(olc::Key::L).bHeld ? 0x00 : 0x08;
+
+        inputs.switches |= GetKey(olc::Key::F1).bHeld ? 0x00 : 0x01;
+        inputs.switches |= GetKey(olc::Key::F2).bHeld ? 0x00 : 0x02;
+        inputs.switches |= GetKey(olc::Key::F3).bHeld ? 0x00 : 0x08;
+        inputs.switches |= GetKey(olc::Key::F4).bHeld ? 0x00 : 0x40;
+        inputs.switches |= GetKey(olc::Key::F5).bHeld ? 0x00 : 0x80;
+
+        inputs.button0 |= GetKey(olc::Key::C).bHeld ? 0x00 : 0x80;
+        inputs.button1 |= GetKey(olc::Key::M).bHeld ? 0x00 : 0x80;
+
+        return inputs;
+    }
+
+    /**
+     * Put a completed frame on the screen. The screen is the size of a frame and nothing else is
+     * drawn on it, so the colors go straight into the engine's draw target, the very buffer it
+     * uploads to the display after every update, rather than into a sprite drawn over it pixel by
+     * pixel. The target keeps the last frame through updates which don't run any.
+     */
+    void presentFrame(const uint8_t* frame) override {
+        TIA::expand(frame, reinterpret_cast<uint32_t*>(GetDrawTarget()->GetData()));
+    }
+
+    bool OnUserUpdate(float) override {
+        // The engine uploads the draw target and swaps buffers between two updates, so the frames
+        // the last one ran are on the display by now
+        if (m_framesRun) {
+            m_pacer.framePresented();
+        }
+
+        m_atari.pollInputs();
+        m_pacer.inputsPolled();
 
 #if 0
         // Debugging commands
@@ -148,40 +195,167 @@ private:
         if (GetKey(olc::Key::R).bPressed) {
             m_atari.reset();
         }
+
+        // Quick save and load, next to the ROM
+        if (GetKey(olc::Key::F6).bPressed) {
+            std::ofstream ofs(m_romPath + ".state", std::ofstream::binary);
+            if (!m_atari.saveState(ofs)) {
+                std::cout << "Error saving state" << std::endl;
+            }
+        }
+        if (GetKey(olc::Key::F7).bPressed) {
+            std::ifstream ifs(m_romPath + ".state", std::ifstream::binary);
+            if (m_atari.loadState(ifs)) {
+                m_pacer.reset(emulatedTime());
+            } else {
+                std::cout << "No saved state for this ROM" << std::endl;
+            }
+        }
         if (GetKey(olc::Key::ESCAPE).bPressed) {
             return false;
         }
 
-        if (m_residualTime > 0.0) {
-            m_residualTime -= elapsedTime;
-        } else {
-            m_residualTime += (1.0f / 60.0f) - elapsedTime;
+        // The sound the audio output has played is the master clock, unless muted
+        if (!m_mute) {
+            m_device.update();
+            m_pacer.reportAudio(OUTPUT_RATE, m_device.m_played, m_device.queued());
+        }
 
-            do {
-                m_atari.step();
-            } while (!m_atari.m_tia.m_frameDone);
+        // Run the frames whose time has come on the master clock (see Pacer), as many as the
+        // window's rate of redraws calls for
+        m_framesRun = 0;
+        while (m_framesRun < MAX_FRAMES_PER_UPDATE && m_pacer.frameDue(emulatedTime())) {
+            runFrame();
+            m_framesRun++;
+        }
 
-            m_atari.m_tia.m_frameDone = false;
+        return true;
+    }
+
+    /**
+     * @brief Run the emulation up to the end of the next frame, and pass its sound on.
+     */
+    void runFrame() {
+        do {
+            m_atari.step();
+        } while (!m_atari.m_tia.m_frameDone);
+
+        m_atari.m_tia.m_frameDone = false;
+
+        // Resample the sound a little faster or slower to keep the audio output's queue where
+        // the pacer wants it
+        size_t count = m_atari.m_tia.m_audio.m_samples.pop(m_samples.data(), m_samples.size());
+        m_resampler.setRatio(AUDIO_RATE / OUTPUT_RATE * m_pacer.getRateAdjustment());
+        count = m_resampler.process(m_samples.data(), count, m_output.data(), m_output.size());
+        m_device.write(m_output.data(), count);
+        m_wav.write(m_output.data(), count);
+
+        // The game's frame timing goes in the title, next to the engine's frame rate
+        const TIA::FrameStats& frames = m_atari.m_tia.m_frameStats;
+        sAppName = "Atari 2600 Emulator - " + std::to_string(frames.scanlines) + " lines";
+        if (frames.jitter) {
+            sAppName += " (" + std::string(frames.jitter > 0 ? "+" : "")
+                + std::to_string(frames.jitter) + ")";
         }
+        if (frames.watchdogFrames == frames.frames) {
+            sAppName += " - no VSYNC";
+        }
+        sAppName += " - input to present "
+            + std::to_string(static_cast<int>(m_pacer.m_metrics.inputToPresent * 1000)) + " ms";
+        if (!m_mute) {
+            sAppName += ", audio "
+                + std::to_string(static_cast<int>(m_pacer.m_metrics.audioLatency * 1000)) + " ms";
+        }
+    }
 
-        DrawSprite(0, 0, &m_atari.m_tia.getScreen(), 1);
+    /**
+     * @brief Seconds the emulated console has run for.
+     */
+    double emulatedTime() const {
+        return m_atari.m_tia.m_clocks / COLOR_CLOCK;
+    }
+
+    bool OnUserDestroy() override {
+        const TIA::FrameStats& frames = m_atari.m_tia.m_frameStats;
+        if (frames.frames) {
+            std::cout << "Frames: " << frames.frames << " (" << frames.watchdogFrames
+                << " ended by the watchdog), " << frames.minScanlines << "-"
+                << frames.maxScanlines << " scanlines" << std::endl;
+        }
+        for (int i = CPU::FUSE_NONE + 1; i < CPU::FUSION_COUNT; i++) {
+            std::cout << "Fused " << CPU::s_fusionNames[i] << ": " << m_atari.m_cpu.m_fusions[i]
+                << std::endl;
+        }
+        if (m_atari.m_jit.m_enabled) {
+            std::cout << "JIT: " << m_atari.m_jit.m_translated << " instructions translated, "
+                << m_atari.m_jit.m_interpreted << " interpreted, "
+                << m_atari.m_jit.m_blocksTranslated << " blocks" << std::endl;
+        }
+        if (m_atari.m_plugin.m_loaded) {
+            std::cout << "AOT: " << m_atari.m_plugin.m_recompiled << " instructions recompiled, "
+                << m_atari.m_plugin.m_interpreted << " interpreted" << std::endl;
+        }
+        const Pacer::Metrics& metrics = m_pacer.m_metrics;
+        std::cout << "Input to present: " << metrics.inputToPresent * 1000 << " ms (max "
+            << metrics.maxInputToPresent * 1000 << " ms), " << metrics.resyncs << " resyncs"
+            << std::endl;
+        if (!m_mute) {
+            std::cout << "Audio latency: " << metrics.audioLatency * 1000 << " ms, "
+                << m_device.m_underrun * 1000.0 / OUTPUT_RATE << " ms of underruns, "
+                << m_device.m_overrun * 1000.0 / OUTPUT_RATE << " ms of overruns" << std::endl;
+        }
 
         return true;
     }
 
     Atari m_atari;
-    float m_residualTime = 0.0f;
+    Pacer m_pacer;
+
+    // Frames the last update ran, presented once it returns
+    int m_framesRun = 0;
     std::string m_romPath;
+    bool m_jit;
+    std::string m_pluginPath;
+    std::string m_wavPath;
+    bool m_mute;
+
+    // No audio library is linked, so the sound is played to a device which only keeps its time
+    NullAudioDevice m_device;
+    WavSink m_wav;
+    Resampler m_resampler;
+    std::array<float, AUDIO_BUFFER> m_samples;
+    std::array<float, 2 * AUDIO_BUFFER> m_output;
 };
 
 int main(int argc, char* argv[]) {
-    if (argc > 1) {
-        Atari2600Emulator emu{argv[1]};
+    std::string romPath;
+    std::string pluginPath;
+    std::string wavPath;
+    bool jit = false;
+    bool mute = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]) == "--jit") {
+            jit = true;
+        } else if (std::string(argv[i]) == "--aot" && i + 1 < argc) {
+            pluginPath = argv[++i];
+        } else if (std::string(argv[i]) == "--wav" && i + 1 < argc) {
+            wavPath = argv[++i];
+        } else if (std::string(argv[i]) == "--mute") {
+            mute = true;
+        } else {
+            romPath = argv[i];
+        }
+    }
+
+    if (!romPath.empty()) {
+        Atari2600Emulator emu{romPath, jit, pluginPath, wavPath, mute};
         if (emu.Construct(WIDTH, HEIGHT, 4, 2)) {
             emu.Start();
         }
     } else {
-        std::cout << "Provide path to ROM" << std::endl;
+        std::cout << "Usage: " << argv[0]
+            << " [--jit] [--aot PLUGIN_DIRECTORY] [--wav FILE] [--mute] ROM" << std::endl;
     }
 
     return 0;
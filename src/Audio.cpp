@@ -0,0 +1,177 @@
+/*
+ *                                 $$ $$$$$ $$
+ *                                 $$ $$$$$ $$
+ *                                .$$ $$$$$ $$.
+ *                                :$$ $$$$$ $$:
+ *                                $$$ $$$$$ $$$
+ *                                $$$ $$$$$ $$$
+ *                               ,$$$ $$$$$ $$$.
+ *                              ,$$$$ $$$$$ $$$$.
+ *                             ,$$$$; $$$$$ :$$$$.
+ *                            ,$$$$$  $$$$$  $$$$$.
+ *                          ,$$$$$$'  $$$$$  `$$$$$$.
+ *                        ,$$$$$$$'   $$$$$   `$$$$$$$.
+ *                     ,s$$$$$$$'     $$$$$     `$$$$$$$s.
+ *                   $$$$$$$$$'       $$$$$       `$$$$$$$$$
+ *                   $$$$$Y'          $$$$$          `Y$$$$$
+ *
+ * Audio.cpp: class which encapsulates the TIA's two sound generators.
+ *
+ * Each channel divides the audio clock (twice per scanline) by AUDF + 1. The divided clock always
+ * shifts a 5-bit polynomial counter, and drives a 4-bit section whose output, scaled by AUDV, is
+ * the channel's. AUDC selects how the 4-bit section is clocked (bits 0-1: on every clock, on two
+ * clocks out of every 31, or whenever the 5-bit counter puts out a 1) and what it does when it is
+ * (bits 2-3: run a 4-bit polynomial counter, toggle, divide by 6, or pass on a 9-bit polynomial
+ * counter or the 5-bit one). The combinations give the pure tones, buzzes and noises the 2600 is
+ * known for. The model keeps the counters rather than tables of the resulting waveforms, so that
+ * they carry over when a game changes AUDC in the middle of a note.
+ *
+ * Like the rest of the TIA, the channels aren't clocked along with the beam. The samples are
+ * generated in one batch when a sound register is about to be written, with the values the
+ * registers had until then, and when a frame completes, so a typical frame produces one or a few
+ * blocks of samples which are handed to the ring buffer at once.
+ */
+#include "Atari.hpp"
+#include "Audio.hpp"
+
+// Samples generated before they're handed to the ring buffer, about a frame's worth
+#define AUDIO_BLOCK 512
+
+// Output of both channels at full volume
+#define AUDIO_MAX (2 * 0x0F)
+
+Audio::Audio() = default;
+Audio::~Audio() = default;
+
+/**
+ * @brief Apply a write to one of the sound registers AUDC0 to AUDV1. The samples up to the write
+ * have to be generated first (see run()).
+ */
+void Audio::write(uint8_t reg, uint8_t value) {
+    Channel& channel = m_channels[(reg - AUDC0) & 0x01];
+
+    switch (reg) {
+        case AUDC0: case AUDC1: channel.audc = value & 0x0F; break;
+        case AUDF0: case AUDF1: channel.audf = value & 0x1F; break;
+        case AUDV0: case AUDV1: channel.audv = value & 0x0F; break;
+        default: break;
+    }
+}
+
+/**
+ * @brief Generate the samples due before the given color clock and append them to m_samples. If
+ * the audio output doesn't keep up, samples which don't fit are dropped.
+ */
+void Audio::run(uint64_t clock) {
+    float block[AUDIO_BLOCK];
+    size_t count = 0;
+
+    while (m_next < clock) {
+        uint8_t output = 0;
+
+        for (Channel& channel : m_channels) {
+            tick(channel);
+            output += level(channel);
+        }
+
+        block[count++] = output * (1.0f / AUDIO_MAX);
+        m_next += AUDIO_CLOCKS;
+
+        if (count == AUDIO_BLOCK) {
+            m_samples.push(block, count);
+            count = 0;
+        }
+    }
+
+    m_samples.push(block, count);
+}
+
+void Audio::save(State& state) const {
+    state.next = m_next;
+    state.channels = m_channels;
+}
+
+void Audio::load(const State& state) {
+    m_next = state.next;
+    m_channels = state.channels;
+}
+
+/**
+ * @brief Shift a polynomial counter of the given length once to the right, feeding bit 0 XOR the
+ * given tap into the top bit. A counter which is all zeroes is fed a 1, so it can't get stuck.
+ */
+static inline uint16_t shift(uint16_t poly, int length, int tap) {
+    uint16_t feedback = ((poly ^ (poly >> tap)) & 0x01) | (poly == 0);
+    return (poly >> 1) | (feedback << (length - 1));
+}
+
+/**
+ * Run one audio clock through the channel. Every AUDF + 1 of them get through the divider, and
+ * shift the 5-bit counter (x^5 + x^2 + 1, which repeats every 31 clocks). Whether the 4-bit
+ * section is clocked as well depends on AUDC bits 0-1; the divide by 31 gate lets through the
+ * clocks 18 and 13 apart. What the 4-bit section does then depends on bits 2-3: shift its own
+ * counter (x^4 + x + 1, every 15 clocks) and put out bit 0; toggle, for a square wave; in modes
+ * 8 to B, respectively put out a 9-bit counter (x^9 + x^4 + 1, every 511 clocks), put out the
+ * 5-bit one, toggle, or nothing (see level()); or toggle every third time, dividing by 6.
+ */
+void Audio::tick(Channel& channel) {
+    if (channel.divider < channel.audf) {
+        channel.divider++;
+        return;
+    }
+    channel.divider = 0;
+
+    bool gate = channel.div31 == 0 || channel.div31 == 18;
+    channel.div31 = channel.div31 == 30 ? 0 : channel.div31 + 1;
+    channel.poly5 = shift(channel.poly5, 5, 2);
+
+    switch (channel.audc & 0x03) {
+        case 0x02:
+            if (!gate) {
+                return;
+            }
+            break;
+        case 0x03:
+            if (!(channel.poly5 & 0x01)) {
+                return;
+            }
+            break;
+        default:
+            break;
+    }
+
+    switch (channel.audc >> 2) {
+        case 0x00:
+            channel.poly4 = shift(channel.poly4, 4, 1);
+            channel.output = channel.poly4 & 0x01;
+            break;
+        case 0x01:
+            channel.output ^= 0x01;
+            break;
+        case 0x02:
+            if (channel.audc == 0x08) {
+                channel.poly9 = shift(channel.poly9, 9, 4);
+                channel.output = channel.poly9 & 0x01;
+            } else if (channel.audc == 0x09) {
+                channel.output = channel.poly5 & 0x01;
+            } else if (channel.audc == 0x0A) {
+                channel.output ^= 0x01;
+            }
+            break;
+        case 0x03:
+            if (++channel.div3 == 3) {
+                channel.div3 = 0;
+                channel.output ^= 0x01;
+            }
+            break;
+    }
+}
+
+/**
+ * @brief The channel's output, 0 to 15. AUDC 0 and B hold the output at AUDV, whatever the
+ * counters do.
+ */
+uint8_t Audio::level(const Channel& channel) {
+    bool high = channel.audc == 0x00 || channel.audc == 0x0B || channel.output;
+    return high ? channel.audv : 0;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+#include "RingBuffer.hpp"
+
+// The TIA's color clock (NTSC), in Hz
+#define COLOR_CLOCK 3579545.0
+
+// Color clocks per audio sample: the TIA clocks its audio twice every scanline
+#define AUDIO_CLOCKS 114
+
+// Samples per second the TIA produces (about 31.4 kHz)
+#define AUDIO_RATE (COLOR_CLOCK / AUDIO_CLOCKS)
+
+// Samples the buffer between the emulation and the audio output holds, about half a second
+#define AUDIO_BUFFER 16384
+
+class Audio {
+public:
+    /**
+     * One of the two sound generators: the AUDC, AUDF and AUDV registers and the counters they
+     * drive. Flags are kept as bytes so the channel stays a plain struct (see State).
+     */
+    struct Channel {
+        uint8_t audc;
+        uint8_t audf;
+        uint8_t audv;
+
+        // Audio clocks counted towards the next of every AUDF + 1, which clock the channel
+        uint8_t divider;
+
+        // Position within the 31 clocks of the divide by 31 gate
+        uint8_t div31;
+
+        // Polynomial counters (shift registers with feedback), 4, 5 and 9 bits long
+        uint8_t poly4;
+        uint8_t poly5;
+        uint16_t poly9;
+
+        // Clocks of the 4-bit section counted towards its next toggle when it divides by 6
+        uint8_t div3;
+
+        // Output of the 4-bit section; the channel is at AUDV while it's set
+        uint8_t output;
+    };
+
+    /**
+     * Everything the sound depends on from here on, as a plain struct to snapshot (see
+     * TIA::State). Samples already produced are left out.
+     */
+    struct State {
+        uint64_t next;
+        std::array<Channel, 2> channels;
+    };
+
+    Audio();
+    ~Audio();
+
+    void write(uint8_t reg, uint8_t value);
+    void run(uint64_t clock);
+    void save(State& state) const;
+    void load(const State& state);
+
+    // Samples produced so far, from 0 (silence) to 1 (both channels at full volume), for the
+    // audio output to drain from its own thread
+    RingBuffer<float, AUDIO_BUFFER> m_samples;
+
+private:
+    static void tick(Channel& channel);
+    static uint8_t level(const Channel& channel);
+
+    std::array<Channel, 2> m_channels = {};
+
+    // Color clock of the next sample
+    uint64_t m_next = 0;
+};
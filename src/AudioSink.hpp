@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstddef>
+
+/**
+ * Where the frontends send the sound once it's resampled to the rate the sink was set up with
+ * (see Resampler), such as an audio device or a file.
+ */
+class AudioSink {
+public:
+    virtual ~AudioSink() = default;
+
+    virtual void write(const float* samples, size_t count) = 0;
+};
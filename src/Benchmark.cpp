@@ -0,0 +1,154 @@
+/**
+ *                                 $$ $$$$$ $$
+ *                                 $$ $$$$$ $$
+ *                                .$$ $$$$$ $$.
+ *                                :$$ $$$$$ $$:
+ *                                $$$ $$$$$ $$$
+ *                                $$$ $$$$$ $$$
+ *                               ,$$$ $$$$$ $$$.
+ *                              ,$$$$ $$$$$ $$$$.
+ *                             ,$$$$; $$$$$ :$$$$.
+ *                            ,$$$$$  $$$$$  $$$$$.
+ *                          ,$$$$$$'  $$$$$  `$$$$$$.
+ *                        ,$$$$$$$'   $$$$$   `$$$$$$$.
+ *                     ,s$$$$$$$'     $$$$$     `$$$$$$$s.
+ *                   $$$$$$$$$'       $$$$$       `$$$$$$$$$
+ *                   $$$$$Y'          $$$$$          `Y$$$$$
+ *
+ * Benchmark.cpp: microbenchmarks of the emulator's hot paths, printing the average cost of one
+ * operation of each.
+ *
+ * Usage: benchmark
+ */
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#include "Atari.hpp"
+#include "Resampler.hpp"
+
+// Operations timed per benchmark
+#define ITERATIONS 50000000
+
+// CPU cycles between two catch-ups of the TIA in the TIA write benchmarks, about a scanline
+#define TIA_CATCH_UP 64
+
+// Seconds of sound each resampler benchmark converts, and the rate it converts to
+#define RESAMPLER_SECONDS 20
+#define RESAMPLER_RATE 48000
+
+/**
+ * @brief Time the given operation, called with the iteration number, and print its average cost.
+ */
+template <typename Operation>
+static void measure(const char* name, Operation operation) {
+    auto start = std::chrono::steady_clock::now();
+
+    for (uint32_t i = 0; i < ITERATIONS; i++) {
+        operation(i);
+    }
+
+    std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    printf("%-24s %6.2f ns\n", name, elapsed.count() / ITERATIONS);
+}
+
+/**
+ * Time the resampler converting the TIA's sound to RESAMPLER_RATE with each quality level and
+ * each kernel the CPU runs, fed in blocks of about a frame like the emulator does, and print the
+ * output samples it produces per second.
+ */
+static void measureResampler() {
+    static const char* const qualities[] = { "low", "medium", "high" };
+    static const char* const kernels[] = { "scalar", "SSE", "AVX2" };
+    std::vector<float> input(static_cast<size_t>(AUDIO_RATE));
+    std::vector<float> output(2 * RESAMPLER_RATE);
+
+    // A square wave, the kind of sound the TIA makes
+    for (size_t i = 0; i < input.size(); i++) {
+        input[i] = (i / 16) & 0x01 ? 0.5f : 0.0f;
+    }
+
+    for (int quality = 0; quality < 3; quality++) {
+        for (int kernel = 0; kernel <= static_cast<int>(Resampler::bestKernel()); kernel++) {
+            Resampler resampler;
+            uint64_t produced = 0;
+
+            resampler.configure(AUDIO_RATE, RESAMPLER_RATE,
+                static_cast<Resampler::Quality>(quality));
+            resampler.setKernel(static_cast<Resampler::Kernel>(kernel));
+
+            auto start = std::chrono::steady_clock::now();
+            for (int second = 0; second < RESAMPLER_SECONDS; second++) {
+                for (size_t i = 0; i < input.size(); i += 512) {
+                    size_t count = std::min<size_t>(512, input.size() - i);
+                    produced += resampler.process(&input[i], count, output.data(), output.size());
+                }
+            }
+
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            char name[32];
+            snprintf(name, sizeof(name), "resample %s %s", qualities[quality], kernels[kernel]);
+            printf("%-24s %6.2f Msamples/s\n", name, produced / elapsed.count() / 1e6);
+        }
+    }
+}
+
+static Atari atari;
+
+/**
+ * @brief Write a TIA register on the next CPU cycle, catching the TIA up every TIA_CATCH_UP
+ * cycles so that its queue of writes stays short.
+ */
+static void writeTia(uint16_t addr, uint8_t data) {
+    atari.m_cycles++;
+    atari.write8(addr, data);
+
+    if (atari.m_cycles % TIA_CATCH_UP == 0) {
+        atari.sync();
+    }
+}
+
+int main() {
+    atari.reset();
+
+    // Bus accesses while the CPU doesn't run, so that the TIA never has anything to catch up on
+    measure("sync", [](uint32_t) { atari.sync(); });
+    measure("write8 RAM", [](uint32_t i) { atari.write8(0x80 | (i & 0x7F), i); });
+    measure("write8 RIOT timer", [](uint32_t i) { atari.write8(TIM1T + (i & 0x03), i); });
+    measure("read8 INTIM", [](uint32_t) { atari.read8(INTIM); });
+
+    // TIA writes are queued for the TIA to apply once it gets to their clock, so they're made the
+    // way a running CPU makes them: one per cycle, the TIA catching up every TIA_CATCH_UP cycles as
+    // a read of one of its registers would make it. Their cost includes applying them, and the
+    // three color clocks the TIA runs for each.
+    measure("write8 TIA register", [](uint32_t i) { writeTia(COLUP0 + (i & 0x03), i); });
+    measure("write8 TIA strobe", [](uint32_t i) { writeTia(RESP0 + (i & 0x03), i); });
+    measure("write8 TIA CXCLR", [](uint32_t i) { writeTia(CXCLR, i); });
+
+    // Snapshots, as rewinding or searching through states would take them, of a machine fresh
+    // from reset with nothing queued
+    static Atari fresh;
+    static Atari::State state;
+    static bool saved = true;
+    fresh.reset();
+    measure("save state", [](uint32_t) { saved &= fresh.save(state); });
+    if (!saved) {
+        printf("Saving the state failed\n");
+        return 1;
+    }
+    measure("load state", [](uint32_t) { fresh.load(state); });
+
+    // Sound, a sample at a time, drained as often as the audio output would
+    static Audio audio;
+    static float samples[AUDIO_BUFFER];
+    audio.write(AUDC0, 0x08);
+    audio.write(AUDV0, 0x0F);
+    measure("audio sample", [](uint32_t i) {
+        audio.run(static_cast<uint64_t>(i + 1) * AUDIO_CLOCKS);
+        if ((i & 0x1FF) == 0) {
+            audio.m_samples.pop(samples, AUDIO_BUFFER);
+        }
+    });
+    measureResampler();
+    return 0;
+}
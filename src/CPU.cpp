@@ -17,38 +17,131 @@
  *
  * CPU.cpp: class which programmatically recreates the Atari 2600's MOS 6507 CPU
  */
+#include <algorithm>
 #include <iostream>
+#include <type_traits>
 
 #include "Atari.hpp"
 #include "CPU.hpp"
 
-CPU::CPU() {
-    m_instRom = {{
-        /*                   0x0                               0x1                               0x2                               0x3                               0x4                               0x5                               0x6                               0x7                               0x8                               0x9                               0xA                               0xB                               0xC                               0xD                               0xE                               0xF              */
-        /*0x0*/{"BRK", &CPU::BRK, &CPU::IMP, 7}, {"ORA", &CPU::ORA, &CPU::IDX, 6}, {"KIL", &CPU::KIL, &CPU::IMP, 2}, {"SLO", &CPU::SLO, &CPU::IDX, 8}, {"DOP", &CPU::DOP, &CPU::ZRP, 3}, {"ORA", &CPU::ORA, &CPU::ZRP, 3}, {"ASL", &CPU::ASL, &CPU::ZRP, 5}, {"SLO", &CPU::SLO, &CPU::ZRP, 5}, {"PHP", &CPU::PHP, &CPU::IMP, 3}, {"ORA", &CPU::ORA, &CPU::IMM, 2}, {"ASL", &CPU::ASL, &CPU::ACC, 2}, {"ANC", &CPU::ANC, &CPU::IMM, 2}, {"TOP", &CPU::TOP, &CPU::ZRP, 4}, {"ORA", &CPU::ORA, &CPU::ABS, 4}, {"ASL", &CPU::ASL, &CPU::ABS, 6}, {"SLO", &CPU::SLO, &CPU::ABS, 6},
-        /*0x1*/{"BPL", &CPU::BPL, &CPU::REL, 2}, {"ORA", &CPU::ORA, &CPU::IDY, 5}, {"KIL", &CPU::KIL, &CPU::IMP, 2}, {"SLO", &CPU::SLO, &CPU::IDY, 8}, {"DOP", &CPU::DOP, &CPU::ZPX, 4}, {"ORA", &CPU::ORA, &CPU::ZPX, 4}, {"ASL", &CPU::ASL, &CPU::ZPX, 6}, {"SLO", &CPU::SLO, &CPU::ZPX, 6}, {"CLC", &CPU::CLC, &CPU::IMP, 2}, {"ORA", &CPU::ORA, &CPU::ABY, 4}, {"NOP", &CPU::NOP, &CPU::IMP, 2}, {"SLO", &CPU::SLO, &CPU::ABY, 7}, {"TOP", &CPU::TOP, &CPU::ZPX, 4}, {"ORA", &CPU::ORA, &CPU::ABX, 4}, {"ASL", &CPU::ASL, &CPU::ABX, 7}, {"SLO", &CPU::SLO, &CPU::ABX, 7},
-        /*0x2*/{"JSR", &CPU::JSR, &CPU::ABS, 6}, {"AND", &CPU::AND, &CPU::IDX, 6}, {"KIL", &CPU::KIL, &CPU::IMP, 2}, {"RLA", &CPU::RLA, &CPU::IDX, 8}, {"BIT", &CPU::BIT, &CPU::ZRP, 3}, {"AND", &CPU::AND, &CPU::ZRP, 3}, {"ROL", &CPU::ROL, &CPU::ZRP, 5}, {"RLA", &CPU::RLA, &CPU::ZRP, 5}, {"PLP", &CPU::PLP, &CPU::IMP, 4}, {"AND", &CPU::AND, &CPU::IMM, 2}, {"ROL", &CPU::ROL, &CPU::ACC, 2}, {"ANC", &CPU::ANC, &CPU::IMM, 2}, {"BIT", &CPU::BIT, &CPU::ABS, 4}, {"AND", &CPU::AND, &CPU::ABS, 4}, {"ROL", &CPU::ROL, &CPU::ABS, 6}, {"RLA", &CPU::RLA, &CPU::ABS, 6},
-        /*0x3*/{"BMI", &CPU::BMI, &CPU::REL, 2}, {"AND", &CPU::AND, &CPU::IDY, 5}, {"KIL", &CPU::KIL, &CPU::IMP, 2}, {"RLA", &CPU::RLA, &CPU::IDY, 8}, {"DOP", &CPU::DOP, &CPU::ZPX, 4}, {"AND", &CPU::AND, &CPU::ZPX, 4}, {"ROL", &CPU::ROL, &CPU::ZPX, 6}, {"RLA", &CPU::RLA, &CPU::ZPX, 6}, {"SEC", &CPU::SEC, &CPU::IMP, 2}, {"AND", &CPU::AND, &CPU::ABY, 4}, {"NOP", &CPU::NOP, &CPU::IMP, 2}, {"RLA", &CPU::RLA, &CPU::ABY, 7}, {"TOP", &CPU::TOP, &CPU::ABX, 4}, {"AND", &CPU::AND, &CPU::ABX, 4}, {"ROL", &CPU::ROL, &CPU::ABX, 7}, {"RLA", &CPU::RLA, &CPU::ABX, 7},
-        /*0x4*/{"RTI", &CPU::RTI, &CPU::IMP, 6}, {"EOR", &CPU::EOR, &CPU::IDX, 6}, {"KIL", &CPU::KIL, &CPU::IMP, 2}, {"SRE", &CPU::SRE, &CPU::IDX, 8}, {"DOP", &CPU::DOP, &CPU::ZRP, 3}, {"EOR", &CPU::EOR, &CPU::ZRP, 3}, {"LSR", &CPU::LSR, &CPU::ZRP, 5}, {"SRE", &CPU::SRE, &CPU::ZRP, 5}, {"PHA", &CPU::PHA, &CPU::IMP, 3}, {"EOR", &CPU::EOR, &CPU::IMM, 2}, {"LSR", &CPU::LSR, &CPU::ACC, 2}, {"ASR", &CPU::ASR, &CPU::IMM, 2}, {"JMP", &CPU::JMP, &CPU::ABS, 3}, {"EOR", &CPU::EOR, &CPU::ABS, 4}, {"LSR", &CPU::LSR, &CPU::ABS, 6}, {"SRE", &CPU::SRE, &CPU::ABS, 6},
-        /*0x5*/{"BVC", &CPU::BVC, &CPU::REL, 2}, {"EOR", &CPU::EOR, &CPU::IDY, 5}, {"KIL", &CPU::KIL, &CPU::IMP, 2}, {"SRE", &CPU::SRE, &CPU::IDY, 8}, {"DOP", &CPU::DOP, &CPU::ZPX, 4}, {"EOR", &CPU::EOR, &CPU::ZPX, 4}, {"LSR", &CPU::LSR, &CPU::ZPX, 6}, {"SRE", &CPU::SRE, &CPU::ZPX, 6}, {"CLI", &CPU::CLI, &CPU::IMP, 2}, {"EOR", &CPU::EOR, &CPU::ABY, 4}, {"NOP", &CPU::NOP, &CPU::IMP, 2}, {"SRE", &CPU::SRE, &CPU::ABY, 7}, {"TOP", &CPU::TOP, &CPU::ABX, 4}, {"EOR", &CPU::EOR, &CPU::ABX, 4}, {"LSR", &CPU::LSR, &CPU::ABX, 7}, {"SRE", &CPU::SRE, &CPU::ABX, 7},
-        /*0x6*/{"RTS", &CPU::RTS, &CPU::IMP, 6}, {"ADC", &CPU::ADC, &CPU::IDX, 6}, {"KIL", &CPU::KIL, &CPU::IMP, 2}, {"RRA", &CPU::RRA, &CPU::IDX, 8}, {"DOP", &CPU::DOP, &CPU::ZRP, 3}, {"ADC", &CPU::ADC, &CPU::ZRP, 3}, {"ROR", &CPU::ROR, &CPU::ZRP, 5}, {"RRA", &CPU::RRA, &CPU::ZRP, 5}, {"PLA", &CPU::PLA, &CPU::IMP, 4}, {"ADC", &CPU::ADC, &CPU::IMM, 2}, {"ROR", &CPU::ROR, &CPU::ACC, 2}, {"ARR", &CPU::ARR, &CPU::IMM, 2}, {"JMP", &CPU::JMP, &CPU::IND, 5}, {"ADC", &CPU::ADC, &CPU::ABS, 4}, {"ROR", &CPU::ROR, &CPU::ABS, 6}, {"RRA", &CPU::RRA, &CPU::ABS, 6},
-        /*0x7*/{"BVS", &CPU::BVS, &CPU::REL, 2}, {"ADC", &CPU::ADC, &CPU::IDY, 5}, {"KIL", &CPU::KIL, &CPU::IMP, 2}, {"RRA", &CPU::RRA, &CPU::IDY, 8}, {"DOP", &CPU::DOP, &CPU::ZPX, 4}, {"ADC", &CPU::ADC, &CPU::ZPX, 4}, {"ROR", &CPU::ROR, &CPU::ZPX, 6}, {"RRA", &CPU::RRA, &CPU::ZPX, 6}, {"SEI", &CPU::SEI, &CPU::IMP, 2}, {"ADC", &CPU::ADC, &CPU::ABY, 4}, {"NOP", &CPU::NOP, &CPU::IMP, 2}, {"RRA", &CPU::RRA, &CPU::ABY, 7}, {"TOP", &CPU::TOP, &CPU::ABX, 4}, {"ADC", &CPU::ADC, &CPU::ABX, 4}, {"ROR", &CPU::ROR, &CPU::ABX, 7}, {"RRA", &CPU::RRA, &CPU::ABX, 7},
-        /*0x8*/{"DOP", &CPU::DOP, &CPU::IMM, 2}, {"STA", &CPU::STA, &CPU::IDX, 6}, {"DOP", &CPU::DOP, &CPU::IMM, 2}, {"SAX", &CPU::SAX, &CPU::IDX, 6}, {"STY", &CPU::STY, &CPU::ZRP, 3}, {"STA", &CPU::STA, &CPU::ZRP, 3}, {"STX", &CPU::STX, &CPU::ZRP, 3}, {"SAX", &CPU::SAX, &CPU::ZRP, 3}, {"DEY", &CPU::DEY, &CPU::IMP, 2}, {"DOP", &CPU::DOP, &CPU::IMM, 2}, {"TXA", &CPU::TXA, &CPU::IMP, 2}, {"ANE", &CPU::ANE, &CPU::IMM, 2}, {"STY", &CPU::STY, &CPU::ABS, 4}, {"STA", &CPU::STA, &CPU::ABS, 4}, {"STX", &CPU::STX, &CPU::ABS, 4}, {"SAX", &CPU::SAX, &CPU::ABS, 4},
-        /*0x9*/{"BCC", &CPU::BCC, &CPU::REL, 2}, {"STA", &CPU::STA, &CPU::IDY, 6}, {"KIL", &CPU::KIL, &CPU::IMP, 2}, {"SHA", &CPU::SHA, &CPU::IDY, 6}, {"STY", &CPU::STY, &CPU::ZPX, 4}, {"STA", &CPU::STA, &CPU::ZPX, 4}, {"STX", &CPU::STX, &CPU::ZPY, 4}, {"SAX", &CPU::SAX, &CPU::ZPY, 4}, {"TYA", &CPU::TYA, &CPU::IMP, 2}, {"STA", &CPU::STA, &CPU::ABY, 5}, {"TXS", &CPU::TXS, &CPU::IMP, 2}, {"SHS", &CPU::SHS, &CPU::ABY, 5}, {"SHY", &CPU::SHY, &CPU::ABX, 5}, {"STA", &CPU::STA, &CPU::ABX, 5}, {"SHX", &CPU::SHX, &CPU::ABY, 5}, {"SHA", &CPU::SHA, &CPU::ABY, 5},
-        /*0xA*/{"LDY", &CPU::LDY, &CPU::IMM, 2}, {"LDA", &CPU::LDA, &CPU::IDX, 6}, {"LDX", &CPU::LDX, &CPU::IMM, 2}, {"LAX", &CPU::LAX, &CPU::IDX, 6}, {"LDY", &CPU::LDY, &CPU::ZRP, 3}, {"LDA", &CPU::LDA, &CPU::ZRP, 3}, {"LDX", &CPU::LDX, &CPU::ZRP, 3}, {"LAX", &CPU::LAX, &CPU::ZRP, 3}, {"TAY", &CPU::TAY, &CPU::IMP, 2}, {"LDA", &CPU::LDA, &CPU::IMM, 2}, {"TAX", &CPU::TAX, &CPU::IMP, 2}, {"LXA", &CPU::LXA, &CPU::IMM, 2}, {"LDY", &CPU::LDY, &CPU::ABS, 4}, {"LDA", &CPU::LDA, &CPU::ABS, 4}, {"LDX", &CPU::LDX, &CPU::ABS, 4}, {"LAX", &CPU::LAX, &CPU::ABS, 4},
-        /*0xB*/{"BCS", &CPU::BCS, &CPU::REL, 2}, {"LDA", &CPU::LDA, &CPU::IDY, 5}, {"KIL", &CPU::KIL, &CPU::IMP, 2}, {"LAX", &CPU::LAX, &CPU::IDY, 5}, {"LDY", &CPU::LDY, &CPU::ZPX, 4}, {"LDA", &CPU::LDA, &CPU::ZPX, 4}, {"LDX", &CPU::LDX, &CPU::ZPY, 4}, {"LAX", &CPU::LAX, &CPU::ZPY, 4}, {"CLV", &CPU::CLV, &CPU::IMP, 2}, {"LDA", &CPU::LDA, &CPU::ABY, 4}, {"TSX", &CPU::TSX, &CPU::IMP, 2}, {"LAS", &CPU::LAS, &CPU::ABY, 4}, {"LDY", &CPU::LDY, &CPU::ABX, 4}, {"LDA", &CPU::LDA, &CPU::ABX, 4}, {"LDX", &CPU::LDX, &CPU::ABY, 4}, {"LAX", &CPU::LAX, &CPU::ABY, 4},
-        /*0xC*/{"CPY", &CPU::CPY, &CPU::IMM, 2}, {"CMP", &CPU::CMP, &CPU::IDX, 6}, {"DOP", &CPU::DOP, &CPU::IMM, 2}, {"DCP", &CPU::DCP, &CPU::IDX, 8}, {"CPY", &CPU::CPY, &CPU::ZRP, 3}, {"CMP", &CPU::CMP, &CPU::ZRP, 3}, {"DEC", &CPU::DEC, &CPU::ZRP, 5}, {"DCP", &CPU::DCP, &CPU::ZRP, 5}, {"INY", &CPU::INY, &CPU::IMP, 2}, {"CMP", &CPU::CMP, &CPU::IMM, 2}, {"DEX", &CPU::DEX, &CPU::IMP, 2}, {"SBX", &CPU::SBX, &CPU::IMP, 2}, {"CPY", &CPU::CPY, &CPU::ABS, 4}, {"CMP", &CPU::CMP, &CPU::ABS, 4}, {"DEC", &CPU::DEC, &CPU::ABS, 6}, {"DCP", &CPU::DCP, &CPU::ABS, 6},
-        /*0xE*/{"BNE", &CPU::BNE, &CPU::REL, 2}, {"CMP", &CPU::CMP, &CPU::IDY, 5}, {"KIL", &CPU::KIL, &CPU::IMP, 2}, {"DCP", &CPU::DCP, &CPU::IDY, 8}, {"DOP", &CPU::DOP, &CPU::ZPX, 4}, {"CMP", &CPU::CMP, &CPU::ZPX, 4}, {"DEC", &CPU::DEC, &CPU::ZPX, 6}, {"DCP", &CPU::DCP, &CPU::ZPX, 6}, {"CLD", &CPU::CLD, &CPU::IMP, 2}, {"CMP", &CPU::CMP, &CPU::ABY, 4}, {"NOP", &CPU::NOP, &CPU::IMP, 2}, {"DCP", &CPU::DCP, &CPU::ABY, 7}, {"TOP", &CPU::TOP, &CPU::ABX, 4}, {"CMP", &CPU::CMP, &CPU::ABX, 4}, {"DEC", &CPU::DEC, &CPU::ABX, 7}, {"DCP", &CPU::DCP, &CPU::ABX, 7},
-        /*0xD*/{"CPX", &CPU::CPX, &CPU::IMM, 2}, {"SBC", &CPU::SBC, &CPU::IDX, 6}, {"DOP", &CPU::DOP, &CPU::IMM, 2}, {"ISB", &CPU::ISB, &CPU::IDX, 8}, {"CPX", &CPU::CPX, &CPU::ZRP, 3}, {"SBC", &CPU::SBC, &CPU::ZRP, 3}, {"INC", &CPU::INC, &CPU::ZRP, 5}, {"ISB", &CPU::ISB, &CPU::ZRP, 5}, {"INX", &CPU::INX, &CPU::IMP, 2}, {"SBC", &CPU::SBC, &CPU::IMM, 2}, {"NOP", &CPU::NOP, &CPU::IMM, 2}, {"SBC", &CPU::SBC, &CPU::IMM, 2}, {"CPX", &CPU::CPX, &CPU::ABS, 4}, {"SBC", &CPU::SBC, &CPU::ABS, 4}, {"INC", &CPU::INC, &CPU::ABS, 6}, {"ISB", &CPU::ISB, &CPU::ABS, 6},
-        /*0xF*/{"BEQ", &CPU::BEQ, &CPU::REL, 2}, {"SBC", &CPU::SBC, &CPU::IDY, 5}, {"KIL", &CPU::KIL, &CPU::IMP, 2}, {"ISB", &CPU::ISB, &CPU::IDY, 8}, {"DOP", &CPU::DOP, &CPU::ZPX, 4}, {"SBC", &CPU::SBC, &CPU::ZPX, 4}, {"INC", &CPU::INC, &CPU::ZPX, 6}, {"ISB", &CPU::ISB, &CPU::ZPX, 6}, {"SED", &CPU::SED, &CPU::IMP, 2}, {"SBC", &CPU::SBC, &CPU::ABY, 4}, {"NOP", &CPU::NOP, &CPU::IMP, 2}, {"ISB", &CPU::ISB, &CPU::ABY, 7}, {"TOP", &CPU::TOP, &CPU::ABX, 4}, {"SBC", &CPU::SBC, &CPU::ABX, 4}, {"INC", &CPU::INC, &CPU::ABX, 7}, {"ISB", &CPU::ISB, &CPU::ABX, 7}
-    }};
+// Operand of a branch which goes back to the load of INTIM right before it
+#define INTIM_LOOP 0xFB
+
+/**
+ * Description of every opcode: the instruction, its addressing mode, and its base cycle count.
+ * This single list is expanded into both the hot dispatch table and the cold mnemonic table.
+ */
+#define INSTRUCTIONS(X) \
+    /*      0x0            0x1            0x2            0x3            0x4            0x5            0x6            0x7            0x8            0x9            0xA            0xB            0xC            0xD            0xE            0xF */         \
+    /*0x0*/ X(BRK, IMP, 7) X(ORA, IDX, 6) X(KIL, IMP, 2) X(SLO, IDX, 8) X(DOP, ZRP, 3) X(ORA, ZRP, 3) X(ASL, ZRP, 5) X(SLO, ZRP, 5) X(PHP, IMP, 3) X(ORA, IMM, 2) X(ASL, ACC, 2) X(ANC, IMM, 2) X(TOP, ZRP, 4) X(ORA, ABS, 4) X(ASL, ABS, 6) X(SLO, ABS, 6) \
+    /*0x1*/ X(BPL, REL, 2) X(ORA, IDY, 5) X(KIL, IMP, 2) X(SLO, IDY, 8) X(DOP, ZPX, 4) X(ORA, ZPX, 4) X(ASL, ZPX, 6) X(SLO, ZPX, 6) X(CLC, IMP, 2) X(ORA, ABY, 4) X(NOP, IMP, 2) X(SLO, ABY, 7) X(TOP, ZPX, 4) X(ORA, ABX, 4) X(ASL, ABX, 7) X(SLO, ABX, 7) \
+    /*0x2*/ X(JSR, ABS, 6) X(AND, IDX, 6) X(KIL, IMP, 2) X(RLA, IDX, 8) X(BIT, ZRP, 3) X(AND, ZRP, 3) X(ROL, ZRP, 5) X(RLA, ZRP, 5) X(PLP, IMP, 4) X(AND, IMM, 2) X(ROL, ACC, 2) X(ANC, IMM, 2) X(BIT, ABS, 4) X(AND, ABS, 4) X(ROL, ABS, 6) X(RLA, ABS, 6) \
+    /*0x3*/ X(BMI, REL, 2) X(AND, IDY, 5) X(KIL, IMP, 2) X(RLA, IDY, 8) X(DOP, ZPX, 4) X(AND, ZPX, 4) X(ROL, ZPX, 6) X(RLA, ZPX, 6) X(SEC, IMP, 2) X(AND, ABY, 4) X(NOP, IMP, 2) X(RLA, ABY, 7) X(TOP, ABX, 4) X(AND, ABX, 4) X(ROL, ABX, 7) X(RLA, ABX, 7) \
+    /*0x4*/ X(RTI, IMP, 6) X(EOR, IDX, 6) X(KIL, IMP, 2) X(SRE, IDX, 8) X(DOP, ZRP, 3) X(EOR, ZRP, 3) X(LSR, ZRP, 5) X(SRE, ZRP, 5) X(PHA, IMP, 3) X(EOR, IMM, 2) X(LSR, ACC, 2) X(ASR, IMM, 2) X(JMP, ABS, 3) X(EOR, ABS, 4) X(LSR, ABS, 6) X(SRE, ABS, 6) \
+    /*0x5*/ X(BVC, REL, 2) X(EOR, IDY, 5) X(KIL, IMP, 2) X(SRE, IDY, 8) X(DOP, ZPX, 4) X(EOR, ZPX, 4) X(LSR, ZPX, 6) X(SRE, ZPX, 6) X(CLI, IMP, 2) X(EOR, ABY, 4) X(NOP, IMP, 2) X(SRE, ABY, 7) X(TOP, ABX, 4) X(EOR, ABX, 4) X(LSR, ABX, 7) X(SRE, ABX, 7) \
+    /*0x6*/ X(RTS, IMP, 6) X(ADC, IDX, 6) X(KIL, IMP, 2) X(RRA, IDX, 8) X(DOP, ZRP, 3) X(ADC, ZRP, 3) X(ROR, ZRP, 5) X(RRA, ZRP, 5) X(PLA, IMP, 4) X(ADC, IMM, 2) X(ROR, ACC, 2) X(ARR, IMM, 2) X(JMP, IND, 5) X(ADC, ABS, 4) X(ROR, ABS, 6) X(RRA, ABS, 6) \
+    /*0x7*/ X(BVS, REL, 2) X(ADC, IDY, 5) X(KIL, IMP, 2) X(RRA, IDY, 8) X(DOP, ZPX, 4) X(ADC, ZPX, 4) X(ROR, ZPX, 6) X(RRA, ZPX, 6) X(SEI, IMP, 2) X(ADC, ABY, 4) X(NOP, IMP, 2) X(RRA, ABY, 7) X(TOP, ABX, 4) X(ADC, ABX, 4) X(ROR, ABX, 7) X(RRA, ABX, 7) \
+    /*0x8*/ X(DOP, IMM, 2) X(STA, IDX, 6) X(DOP, IMM, 2) X(SAX, IDX, 6) X(STY, ZRP, 3) X(STA, ZRP, 3) X(STX, ZRP, 3) X(SAX, ZRP, 3) X(DEY, IMP, 2) X(DOP, IMM, 2) X(TXA, IMP, 2) X(ANE, IMM, 2) X(STY, ABS, 4) X(STA, ABS, 4) X(STX, ABS, 4) X(SAX, ABS, 4) \
+    /*0x9*/ X(BCC, REL, 2) X(STA, IDY, 6) X(KIL, IMP, 2) X(SHA, IDY, 6) X(STY, ZPX, 4) X(STA, ZPX, 4) X(STX, ZPY, 4) X(SAX, ZPY, 4) X(TYA, IMP, 2) X(STA, ABY, 5) X(TXS, IMP, 2) X(SHS, ABY, 5) X(SHY, ABX, 5) X(STA, ABX, 5) X(SHX, ABY, 5) X(SHA, ABY, 5) \
+    /*0xA*/ X(LDY, IMM, 2) X(LDA, IDX, 6) X(LDX, IMM, 2) X(LAX, IDX, 6) X(LDY, ZRP, 3) X(LDA, ZRP, 3) X(LDX, ZRP, 3) X(LAX, ZRP, 3) X(TAY, IMP, 2) X(LDA, IMM, 2) X(TAX, IMP, 2) X(LXA, IMM, 2) X(LDY, ABS, 4) X(LDA, ABS, 4) X(LDX, ABS, 4) X(LAX, ABS, 4) \
+    /*0xB*/ X(BCS, REL, 2) X(LDA, IDY, 5) X(KIL, IMP, 2) X(LAX, IDY, 5) X(LDY, ZPX, 4) X(LDA, ZPX, 4) X(LDX, ZPY, 4) X(LAX, ZPY, 4) X(CLV, IMP, 2) X(LDA, ABY, 4) X(TSX, IMP, 2) X(LAS, ABY, 4) X(LDY, ABX, 4) X(LDA, ABX, 4) X(LDX, ABY, 4) X(LAX, ABY, 4) \
+    /*0xC*/ X(CPY, IMM, 2) X(CMP, IDX, 6) X(DOP, IMM, 2) X(DCP, IDX, 8) X(CPY, ZRP, 3) X(CMP, ZRP, 3) X(DEC, ZRP, 5) X(DCP, ZRP, 5) X(INY, IMP, 2) X(CMP, IMM, 2) X(DEX, IMP, 2) X(SBX, IMP, 2) X(CPY, ABS, 4) X(CMP, ABS, 4) X(DEC, ABS, 6) X(DCP, ABS, 6) \
+    /*0xD*/ X(BNE, REL, 2) X(CMP, IDY, 5) X(KIL, IMP, 2) X(DCP, IDY, 8) X(DOP, ZPX, 4) X(CMP, ZPX, 4) X(DEC, ZPX, 6) X(DCP, ZPX, 6) X(CLD, IMP, 2) X(CMP, ABY, 4) X(NOP, IMP, 2) X(DCP, ABY, 7) X(TOP, ABX, 4) X(CMP, ABX, 4) X(DEC, ABX, 7) X(DCP, ABX, 7) \
+    /*0xE*/ X(CPX, IMM, 2) X(SBC, IDX, 6) X(DOP, IMM, 2) X(ISB, IDX, 8) X(CPX, ZRP, 3) X(SBC, ZRP, 3) X(INC, ZRP, 5) X(ISB, ZRP, 5) X(INX, IMP, 2) X(SBC, IMM, 2) X(NOP, IMM, 2) X(SBC, IMM, 2) X(CPX, ABS, 4) X(SBC, ABS, 4) X(INC, ABS, 6) X(ISB, ABS, 6) \
+    /*0xF*/ X(BEQ, REL, 2) X(SBC, IDY, 5) X(KIL, IMP, 2) X(ISB, IDY, 8) X(DOP, ZPX, 4) X(SBC, ZPX, 4) X(INC, ZPX, 6) X(ISB, ZPX, 6) X(SED, IMP, 2) X(SBC, ABY, 4) X(NOP, IMP, 2) X(ISB, ABY, 7) X(TOP, ABX, 4) X(SBC, ABX, 4) X(INC, ABX, 7) X(ISB, ABX, 7)
+
+/**
+ * @brief Number of bytes the instruction Op occupies with the addressing mode M: the opcode plus
+ * the operand bytes the mode consumes. Instructions which take no argument (e.g. DOP and TOP) step
+ * over their own operand bytes, so only their opcode is decoded.
+ */
+template <CPU::AddrMode M, auto Op>
+constexpr uint8_t CPU::length() {
+    if constexpr (std::is_same_v<decltype(Op), uint8_t (CPU::*)()>) {
+        return 1;
+    } else {
+        switch (M) {
+            case AddrMode::ACC: case AddrMode::IMP: return 1;
+            case AddrMode::ABS: case AddrMode::ABX: case AddrMode::ABY: case AddrMode::IND:
+                return 3;
+            default: return 2;
+        }
+    }
 }
 
+// Distinct type for every instruction handler, so that handlers of any signature compare
+template <auto Op> struct Handler {};
+
+/**
+ * @brief Whether Op is the handler of any of the instructions Ops.
+ */
+template <auto Op, auto... Ops>
+constexpr bool CPU::isAny() {
+    return (std::is_same_v<Handler<Op>, Handler<Ops>> || ...);
+}
+
+/**
+ * @brief Where execution continues after the instruction Op, for the recompilers to find the end
+ * of a block and the blocks following it.
+ */
+template <auto Op>
+constexpr CPU::Flow CPU::flow() {
+    if constexpr (isAny<Op, &CPU::BCC, &CPU::BCS, &CPU::BEQ, &CPU::BMI, &CPU::BNE, &CPU::BPL,
+            &CPU::BVC, &CPU::BVS>()) {
+        return Flow::BRANCH;
+    } else if constexpr (isAny<Op, &CPU::JMP>()) {
+        return Flow::JUMP;
+    } else if constexpr (isAny<Op, &CPU::JSR>()) {
+        return Flow::CALL;
+    } else if constexpr (isAny<Op, &CPU::RTS, &CPU::RTI>()) {
+        return Flow::RETURN;
+    } else if constexpr (isAny<Op, &CPU::BRK>()) {
+        return Flow::BREAK;
+    } else if constexpr (isAny<Op, &CPU::DOP>()) {
+        return Flow::SKIP_BYTE;
+    } else if constexpr (isAny<Op, &CPU::TOP>()) {
+        return Flow::SKIP_WORD;
+    } else if constexpr (isAny<Op, &CPU::KIL>()) {
+        return Flow::HALT;
+    } else {
+        return Flow::NEXT;
+    }
+}
+
+#define INSTRUCTION(op, mode, cycles) \
+    { &CPU::exec<CPU::AddrMode::mode, &CPU::op>, cycles, \
+        CPU::length<CPU::AddrMode::mode, &CPU::op>() },
+#define MNEMONIC(op, mode, cycles) \
+    { #op, CPU::AddrMode::mode, CPU::flow<&CPU::op>(), \
+        std::is_same_v<decltype(&CPU::op), uint8_t (CPU::*)(uint8_t&)> \
+            || CPU::isAny<&CPU::op, &CPU::STA, &CPU::STX, &CPU::STY>(), \
+        CPU::isAny<&CPU::op, &CPU::DCP, &CPU::ISB, &CPU::LAS, &CPU::SAX, &CPU::SHA, &CPU::SHS, \
+            &CPU::SHX, &CPU::SHY>() },
+
+/**
+ * Jump table indexed by opcode. Every entry points at the instruction's handler specialized for
+ * its addressing mode, so the table is fully built at compile time.
+ */
+constexpr std::array<CPU::Instruction, 0x100> CPU::s_instRom = {{ INSTRUCTIONS(INSTRUCTION) }};
+
+/**
+ * Mnemonics, addressing modes, and the properties the recompilers classify instructions by,
+ * indexed by opcode. They are not needed to execute, so they are kept out of the dispatch table.
+ */
+constexpr std::array<CPU::Mnemonic, 0x100> CPU::s_mnemonics = {{ INSTRUCTIONS(MNEMONIC) }};
+
+const std::array<const char*, CPU::FUSION_COUNT> CPU::s_fusionNames = {{
+    "", "STA WSYNC", "DEX; BNE", "LDA (zp),Y; STA GRP0", "load INTIM; branch"
+}};
+
+#undef INSTRUCTION
+#undef MNEMONIC
+
+CPU::CPU() = default;
 CPU::~CPU() = default;
 
 void CPU::connectAtari(Atari* atari) {
     m_atari = atari;
-    m_timer.connectAtari(atari);
 }
 
 /**
@@ -62,27 +155,249 @@ void CPU::reset() {
     m_s = 0xFD;
     m_p = CONSTANT;
     m_cycles = 8; 
+    flushDecodeCache();
+}
+
+void CPU::save(State& state) const {
+    state.cycles = m_cycles;
+    state.pc = m_pc;
+    state.a = m_a;
+    state.x = m_x;
+    state.y = m_y;
+    state.p = m_p;
+    state.s = m_s;
+}
+
+/**
+ * @brief Restore registers saved by save(). The decode cache only depends on the cartridge, so it
+ * stays valid.
+ */
+void CPU::load(const State& state) {
+    m_cycles = state.cycles;
+    m_pc = state.pc;
+    m_a = state.a;
+    m_x = state.x;
+    m_y = state.y;
+    m_p = state.p;
+    m_s = state.s;
+    m_elapsed = 0;
 }
 
 /**
  * Handle the next instruction.
  *
- * First the next opcode is fetched from memory, then this opcode is decoded and executed using a
- * jump table of function pointers which is indexed by the opcode. After this, the number of cycles
- * that instruction takes on the actual MOS 6507 microprocessor is saved; this value is used for
- * timing purposes.
+ * First the instruction at the PC is decoded (taken from the decode cache when it lies in the
+ * cartridge ROM), then it is executed using a jump table of function pointers which is indexed by
+ * the opcode. The whole instruction is executed at once; the number of cycles it takes on the
+ * actual MOS 6507 microprocessor is returned so that the rest of the system can catch up on them.
+ * If the CPU is stalled (as it is right after a reset), the stall is returned instead without
+ * executing anything.
+ *
+ * A common sequence of instructions is executed by a single fused handler instead, as long as the
+ * second instruction starts within the given budget of cycles the rest of the system allows the
+ * CPU to run ahead (the TIA mustn't complete a frame in between).
+ * @return Number of CPU cycles consumed
  */
-void CPU::step() {
+uint32_t CPU::step(uint32_t budget) {
     if (m_cycles == 0) {
-        m_opcode = fetch();
+        const Decoded* inst = &decode(m_pc);
+
+        if (inst->split > budget) {
+            decodeInto(m_uncached, m_pc, false);
+            inst = &m_uncached;
+        }
+
+        m_opcode = inst->opcode;
+        m_operand = inst->operand;
+        m_pc += inst->length;
         m_additionalCycle = 0;
-        m_cycles = m_instRom[m_opcode].cycles;
-        m_cycles += (this->*m_instRom[m_opcode].op)() & m_additionalCycle;
+        m_budget = budget;
+#ifdef CPU_SWITCH_DISPATCH
+        if (inst->fusion == FUSE_NONE) {
+            dispatch();
+        } else {
+            m_cycles = inst->cycles;
+            m_cycles += (this->*inst->exec)() & m_additionalCycle;
+        }
+#else
+        m_cycles = inst->cycles;
+        m_cycles += (this->*inst->exec)() & m_additionalCycle;
+#endif
         logInfo();
     }
 
-    m_timer.step();
-    m_cycles--;
+    uint32_t cycles = m_cycles;
+    m_cycles = 0;
+    return cycles;
+}
+
+#ifdef CPU_SWITCH_DISPATCH
+/**
+ * Alternative to the jump table of function pointers (selected at build time with
+ * CPU_SWITCH_DISPATCH). Every opcode gets its own case, expanded from INSTRUCTIONS in opcode
+ * order, which calls the handler specialized for its addressing mode by name. Executing an
+ * instruction therefore costs a single indexed jump to a direct call the compiler can inline,
+ * without relying on it to fold the constant table into the switch.
+ */
+void CPU::dispatch() {
+    // __COUNTER__ numbers the cases in order of expansion, from 0 on
+    enum { DISPATCH_BASE = __COUNTER__ + 1 };
+
+#define DISPATCH(op, mode, cycles) \
+    case __COUNTER__ - DISPATCH_BASE: \
+        m_cycles = cycles; \
+        m_cycles += exec<AddrMode::mode, &CPU::op>() & m_additionalCycle; \
+        break;
+
+    switch (m_opcode) {
+        INSTRUCTIONS(DISPATCH)
+    }
+
+#undef DISPATCH
+    static_assert(__COUNTER__ - DISPATCH_BASE == 0x100, "one case per opcode");
+}
+#endif
+
+/**
+ * Execute a single instruction which has been decoded elsewhere (used by recompiled code for the
+ * instructions it doesn't implement itself).
+ * @param next Address of the instruction following this one
+ * @return Number of CPU cycles consumed
+ */
+uint8_t CPU::execute(uint8_t opcode, uint16_t operand, uint16_t next) {
+    m_opcode = opcode;
+    m_operand = operand;
+    m_pc = next;
+    m_additionalCycle = 0;
+    m_cycles = s_instRom[opcode].cycles;
+    m_cycles += (this->*s_instRom[opcode].exec)() & m_additionalCycle;
+
+    uint8_t cycles = m_cycles;
+    m_cycles = 0;
+    return cycles;
+}
+
+/**
+ * @brief Number of bytes decoded for the given opcode (see length()).
+ */
+uint8_t CPU::instructionLength(uint8_t opcode) {
+    return s_instRom[opcode].length;
+}
+
+/**
+ * @brief Cycles of the current step after which the instruction being executed ends, not counting
+ * an additional cycle it may still report.
+ */
+uint32_t CPU::instructionEnd() const {
+    return m_elapsed + s_instRom[m_opcode].cycles;
+}
+
+/**
+ * @brief Return the decoded instruction at the given address. Instructions in the cartridge ROM are
+ * decoded once and cached; anything else (e.g. code copied into RIOT RAM) is decoded every time.
+ */
+inline const CPU::Decoded& CPU::decode(uint16_t pc) {
+    if (Atari::isCart(pc)) {
+        Decoded& inst = m_decodeCache[pc & (SIZE_CART - 1)];
+
+        if (!inst.exec) {
+            decodeInto(inst, pc, true);
+        }
+
+        return inst;
+    }
+
+    decodeInto(m_uncached, pc, true);
+    return m_uncached;
+}
+
+/**
+ * @brief Fetch the opcode at the given address and the operand bytes its addressing mode uses, or
+ * the whole sequence if it starts a fused one (and fuse is set).
+ */
+inline void CPU::decodeInto(Decoded& inst, uint16_t pc, bool fuse) {
+    inst.opcode = read8(pc);
+
+    const Instruction& entry = s_instRom[inst.opcode];
+
+    inst.exec = entry.exec;
+    inst.cycles = entry.cycles;
+    inst.length = entry.length;
+    inst.operand = 0x0000;
+    if (entry.length == 2) {
+        inst.operand = read8(pc + 1);
+    } else if (entry.length == 3) {
+        inst.operand = read16(pc + 1);
+    }
+
+    inst.fusion = FUSE_NONE;
+    inst.split = 0;
+    if (fuse) {
+        this->fuse(inst, pc);
+    }
+}
+
+/**
+ * @brief Whether the opcode is one a game polls INTIM with: LDA, LDX, LDY or BIT absolute.
+ */
+static constexpr bool isPollLoad(uint8_t opcode) {
+    return opcode == 0xAD || opcode == 0xAE || opcode == 0xAC || opcode == 0x2C;
+}
+
+/**
+ * Whether the opcode is a conditional branch on a flag the given poll of INTIM sets, so that
+ * whether it's taken depends on the value read. Branch opcodes are xxy10000, where xx selects the
+ * flag (N, V, C or Z) and y the value the branch is taken on; only BIT sets V, and none sets C.
+ */
+static constexpr bool isPollBranch(uint8_t load, uint8_t opcode) {
+    uint8_t flag = opcode >> 6;
+    return (opcode & 0x1F) == 0x10 && flag != 2 && (flag != 1 || load == 0x2C);
+}
+
+/**
+ * Turn the decoded instruction into a fused handler if it starts one of the sequences kernels
+ * spend most of their time in. The handler takes the variable operand byte of the sequence; the
+ * cycle count is the combined base cycles of the sequence.
+ */
+inline void CPU::fuse(Decoded& inst, uint16_t pc) {
+    if (inst.opcode == 0x85 && inst.operand == WSYNC) {
+        // STA WSYNC
+        inst.exec = &CPU::fuseStaWsync;
+        inst.fusion = FUSE_STA_WSYNC;
+    } else if (inst.opcode == 0xCA && read8(pc + 1) == 0xD0) {
+        // DEX; BNE rel
+        inst.exec = &CPU::fuseDexBne;
+        inst.fusion = FUSE_DEX_BNE;
+        inst.operand = read8(pc + 2);
+        inst.length = 3;
+        inst.cycles = 4;
+        inst.split = 2;
+    } else if (inst.opcode == 0xB1 && read8(pc + 2) == 0x85 && read8(pc + 3) == GRP0) {
+        // LDA (zp),Y; STA GRP0
+        inst.exec = &CPU::fuseLdaIdyStaGrp0;
+        inst.fusion = FUSE_LDA_IDY_STA_GRP0;
+        inst.length = 4;
+        inst.cycles = 8;
+        inst.split = 6;
+    } else if (isPollLoad(inst.opcode) && Atari::isIntim(inst.operand)
+            && isPollBranch(inst.opcode, read8(pc + 3))) {
+        // LDA/LDX/LDY/BIT INTIM; branch on a flag the load sets. The branch's opcode goes in the
+        // upper byte of the operand, its offset in the lower one.
+        inst.exec = &CPU::fusePollIntim;
+        inst.fusion = FUSE_POLL_INTIM;
+        inst.operand = read8(pc + 3) << 8 | read8(pc + 4);
+        inst.length = 5;
+        inst.cycles = 6;
+        inst.split = 4;
+    }
+}
+
+/**
+ * @brief Forget every decoded instruction. Has to be called whenever the contents of the cartridge
+ * window change, e.g. when a ROM is loaded or a bank is switched in.
+ */
+void CPU::flushDecodeCache() {
+    m_decodeCache.fill(Decoded{});
 }
 
 /**
@@ -118,18 +433,13 @@ void CPU::irq() {
  */
 inline void CPU::logInfo() {
 #ifdef DEBUG
-    std::cout << "PC = 0x" << std::hex << PC << ": "
-        << m_instRom[m_opcode].name << " (0x" << std::hex << static_cast<int>(m_opcode)
+    std::cout << "PC = 0x" << std::hex << m_pc << ": "
+        << s_mnemonics[m_opcode].name << " (0x" << std::hex << static_cast<int>(m_opcode)
         << ") A: 0x" << std::hex << static_cast<int>(m_a) << " X: 0x" << std::hex
         << static_cast<int>(m_x) << " Y: 0x" << std::hex << static_cast<int>(m_y) << std::endl;
 #endif
 }
 
-/**
- * @brief Fetch the next byte from RAM pointed to by the CPU's PC register.
- */
-inline uint8_t CPU::fetch() { return read8(m_pc++); }
-
 /**
  * @brief If negative, return offset and subtract 0x0100; otherwise just return offset.
  */
@@ -167,6 +477,17 @@ void CPU::push16(uint16_t data) {
     m_s--;
 }
 
+/**
+ * @brief Perform a read-modify-write of the byte at the given address using the given operation.
+ */
+inline uint8_t CPU::modify(uint16_t address, uint8_t (CPU::*op)(uint8_t&)) {
+    uint8_t value = read8(address);
+    uint8_t additionalCycle = (this->*op)(value);
+
+    write8(address, value);
+    return additionalCycle;
+}
+
 /*******************************************************************************
  *                         Memory addressing modes                             *
  ******************************************************************************/
@@ -174,21 +495,15 @@ void CPU::push16(uint16_t data) {
  * Absolute addressing mode. Here, the two bytes after the opcode are used as an address to be used
  * to load/store to, or the address of the operand to be used in the instruction.
  */
-inline uint16_t CPU::ABS() {
-    uint16_t address = read16(m_pc);
-
-    m_pc += 2;
-    return address;
-}
+inline uint16_t CPU::ABS() { return m_operand; }
 
 /**
  * Absolute Indexed addressing mode. This mode is the same as ABY, but instead of offsetting by
  * the value in the Y register, it offsets by the value in the X register.
  */
 inline uint16_t CPU::ABX() {
-    uint16_t address = read16(m_pc);
+    uint16_t address = m_operand;
 
-    m_pc += 2;
     if (address < 0x100 && address + m_y >= 0x100) {
         // Page boundary crossed
         m_additionalCycle = 1;
@@ -202,9 +517,8 @@ inline uint16_t CPU::ABX() {
  * a base address. This is then offset by the Y register.
  */
 inline uint16_t CPU::ABY() {
-    uint16_t address = read16(m_pc);
+    uint16_t address = m_operand;
 
-    m_pc += 2;
     if (address < 0x100 && address + m_y >= 0x100) {
         // Page boundary crossed
         m_additionalCycle = 1;
@@ -225,7 +539,7 @@ inline uint16_t CPU::ACC() { return 0; }
  * to either use or read from. Depending on instruction, the address or value at that address is
  * used; this is why the address is returned.
  */
-inline uint16_t CPU::IDX() { return read16((fetch() + m_x) & 0xFF); }
+inline uint16_t CPU::IDX() { return read16((m_operand + m_x) & 0xFF); }
 
 /**
  * Indirect Index addressing mode. In this mode the next byte is read from memory, and the value
@@ -233,7 +547,7 @@ inline uint16_t CPU::IDX() { return read16((fetch() + m_x) & 0xFF); }
  * instructions, or the value of the operand to use in other instructions.
  */
 inline uint16_t CPU::IDY() {
-    uint16_t address = read16(fetch());
+    uint16_t address = read16(m_operand);
 
     if (address < 0x100 && address + m_y >= 0x100) {
         // Page boundary crossed
@@ -248,7 +562,7 @@ inline uint16_t CPU::IDY() {
  * of the instruction. Value from memory is returned because no load/store operation uses immediate
  * addressing.
  */
-inline uint16_t CPU::IMM() { return fetch(); }
+inline uint16_t CPU::IMM() { return m_operand; }
 
 /**
  * Implied addressing mode. Here, the instruction is only one byte which is the opcode, so it
@@ -261,9 +575,8 @@ inline uint16_t CPU::IMP() { return 0; }
  * bytes following the opcode be loaded from memory and then stored into the PC register.
  */
 inline uint16_t CPU::IND() {
-    uint16_t address = read16(m_pc);
+    uint16_t address = m_operand;
 
-    m_pc += 2;
     if ((address & 0x00FF) == 0x00FF) {
         return (read8(address & 0xFF00) << 8) | read8(address);
     }
@@ -275,34 +588,95 @@ inline uint16_t CPU::IND() {
  * Relative addressing mode. Used only by branching instructions, this mode uses the byte after
  * the opcode as a signed offset for the PC if the branch is taken.
  */
-inline uint16_t CPU::REL() { return fetch(); }
+inline uint16_t CPU::REL() { return m_operand; }
 
 /**
  * Zero-Page Indexed addressing mode. Here the value of the next byte is added to the X register.
  * This address is returned and not read from memory because instructions like STA required the
  * address, not the value at the address.
  */
-inline uint16_t CPU::ZPX() { return (uint16_t) ((uint8_t) fetch() + m_x); }
+inline uint16_t CPU::ZPX() { return (uint16_t) ((uint8_t) m_operand + m_x); }
 
 /**
  * Zero-Page Index addressing mode. This mode is the same as the previous, only the Y register
  * is added to the next byte and ANDed with 0xFF before being read.
  */
-inline uint16_t CPU::ZPY() { return (fetch() + m_y) & 0xFF; }
+inline uint16_t CPU::ZPY() { return (m_operand + m_y) & 0xFF; }
 
 /**
  * Zero Page addressing mode. The byte after the opcode resides in low memory or the Zero Page
  * of memory. Because different instructions use this address differently (like load/store
  * vs OR), this method only returns the address and not the value at that address.
  */
-inline uint16_t CPU::ZRP() { return fetch(); }
+inline uint16_t CPU::ZRP() { return m_operand; }
+
+/**
+ * @brief Resolve the given addressing mode at compile time.
+ * @return The effective address, or the raw operand for IMM and REL
+ */
+template <CPU::AddrMode M>
+inline uint16_t CPU::resolve() {
+    switch (M) {
+        case AddrMode::ABS: return ABS();
+        case AddrMode::ABX: return ABX();
+        case AddrMode::ABY: return ABY();
+        case AddrMode::ACC: return ACC();
+        case AddrMode::IDX: return IDX();
+        case AddrMode::IDY: return IDY();
+        case AddrMode::IMM: return IMM();
+        case AddrMode::IMP: return IMP();
+        case AddrMode::IND: return IND();
+        case AddrMode::REL: return REL();
+        case AddrMode::ZPX: return ZPX();
+        case AddrMode::ZPY: return ZPY();
+        default: return ZRP();
+    }
+}
+
+/**
+ * @brief Return the 8-bit operand for the given addressing mode: the byte following the opcode for
+ * IMM and REL, and the byte at the effective address for every mode that computes one.
+ */
+template <CPU::AddrMode M>
+inline uint8_t CPU::operand() {
+    if constexpr (M == AddrMode::IMM || M == AddrMode::REL || M == AddrMode::IMP) {
+        return resolve<M>();
+    } else {
+        return read8(resolve<M>());
+    }
+}
+
+/**
+ * Handler for one opcode: the instruction Op combined with the addressing mode M. The kind of
+ * argument Op takes decides how the addressing mode is used; instructions taking a value get the
+ * operand, instructions taking an address get the effective address, and instructions taking a
+ * reference are read-modify-write (on the A register in accumulator mode). Every combination used
+ * by the instruction table is a separate function with the addressing mode inlined into it.
+ * @return 1 if the instruction takes an additional cycle on a page boundary crossing, else 0
+ */
+template <CPU::AddrMode M, auto Op>
+uint8_t CPU::exec() {
+    using OpType = decltype(Op);
+
+    if constexpr (std::is_same_v<OpType, uint8_t (CPU::*)()>) {
+        return (this->*Op)();
+    } else if constexpr (std::is_same_v<OpType, uint8_t (CPU::*)(uint8_t&)>) {
+        if constexpr (M == AddrMode::ACC) {
+            return (this->*Op)(m_a);
+        } else {
+            return modify(resolve<M>(), Op);
+        }
+    } else if constexpr (std::is_same_v<OpType, uint8_t (CPU::*)(uint16_t)>) {
+        return (this->*Op)(resolve<M>());
+    } else {
+        return (this->*Op)(operand<M>());
+    }
+}
 
 /*******************************************************************************
  *                              Instruction Set                                *
  ******************************************************************************/
-uint8_t CPU::ADC() {
-    uint8_t operand = m_opcode == 0x69 ? (this->*m_instRom[m_opcode].addr)()
-        : read8((this->*m_instRom[m_opcode].addr)());
+uint8_t CPU::ADC(uint8_t operand) {
     uint16_t sum = m_a + (m_p & CARRY) + operand;
 
     sum > 0xFF ? setBit(CARRY) : clrBit(CARRY);
@@ -313,29 +687,25 @@ uint8_t CPU::ADC() {
     return 1;
 }
 
-uint8_t CPU::ANC() {
-    uint8_t operand = (this->*m_instRom[m_opcode].addr)();
-
+uint8_t CPU::ANC(uint8_t operand) {
     m_a &= operand;
     setZEROSIGN(m_a);
     m_a & SIGN ? setBit(CARRY) : clrBit(CARRY);
     return 0;
 }
 
-uint8_t CPU::AND() {
-    /* IMM addressing mode has next byte as immediate value, not address */
-    m_a &= m_opcode == 0x29 ? (this->*m_instRom[m_opcode].addr)()
-        : read8((this->*m_instRom[m_opcode].addr)());
+uint8_t CPU::AND(uint8_t operand) {
+    m_a &= operand;
     setZEROSIGN(m_a);
     return 1;
 }
 
 uint8_t CPU::ANE() { return 0; }
 
-uint8_t CPU::ARR() {
+uint8_t CPU::ARR(uint8_t operand) {
     uint8_t flags;
-    uint8_t operand = (this->*m_instRom[m_opcode].addr)() & m_a;
 
+    operand &= m_a;
     m_a = (operand >> 1) | ((m_p & CARRY) ? 0x80 : 0x00);
     setZEROSIGN(m_a);
     flags = m_a & 0x60;
@@ -365,27 +735,15 @@ uint8_t CPU::ARR() {
     return 0;
 }
 
-uint8_t CPU::ASL() {
-    if (m_opcode == 0x0A) {
-        m_a & SIGN ? setBit(CARRY) : clrBit(CARRY);
-        m_a <<= 1;
-        setZEROSIGN(m_a);
-    } else {
-        uint16_t address = (this->*m_instRom[m_opcode].addr)();
-        uint8_t operand = read8(address);
-
-        operand & SIGN ? setBit(CARRY) : clrBit(CARRY);
-        operand <<= 1;
-        setZEROSIGN(operand);
-        write8(address, operand);
-    }
-
+uint8_t CPU::ASL(uint8_t& value) {
+    value & SIGN ? setBit(CARRY) : clrBit(CARRY);
+    value <<= 1;
+    setZEROSIGN(value);
     return 0;
 }
 
-uint8_t CPU::ASR() {
-    uint8_t operand = (this->*m_instRom[m_opcode].addr)() & m_a;
-
+uint8_t CPU::ASR(uint8_t operand) {
+    operand &= m_a;
     operand & 0x01 ? setBit(CARRY) : clrBit(CARRY);
     m_a = operand >> 1;
     m_a ? clrBit(ZERO) : setBit(ZERO);
@@ -393,9 +751,7 @@ uint8_t CPU::ASR() {
     return 0;
 }
 
-uint8_t CPU::BCC() {
-    uint8_t offset = (this->*m_instRom[m_opcode].addr)();
-
+uint8_t CPU::BCC(uint8_t offset) {
     if (!(m_p & CARRY)) {
         if (m_pc < 0x100 && m_pc + relativeOffset(offset) >= 0x100) {
             m_cycles++;
@@ -407,9 +763,7 @@ uint8_t CPU::BCC() {
     return 0;
 }
 
-uint8_t CPU::BCS() {
-    uint8_t offset = (this->*m_instRom[m_opcode].addr)();
-
+uint8_t CPU::BCS(uint8_t offset) {
     if (m_p & CARRY) {
         if (((m_pc + relativeOffset(offset)) & 0xFF00) != (m_pc & 0xFF00)) {
             m_cycles++;
@@ -422,9 +776,7 @@ uint8_t CPU::BCS() {
     return 0;
 }
 
-uint8_t CPU::BEQ() {
-    uint8_t offset = (this->*m_instRom[m_opcode].addr)();
-
+uint8_t CPU::BEQ(uint8_t offset) {
     if (m_p & ZERO) {
         if (((m_pc + relativeOffset(offset)) & 0xFF00) != (m_pc & 0xFF00)) {
             m_cycles++;
@@ -437,18 +789,14 @@ uint8_t CPU::BEQ() {
     return 0;
 }
 
-uint8_t CPU::BIT() {
-    uint8_t operand = read8((this->*m_instRom[m_opcode].addr)());
-
+uint8_t CPU::BIT(uint8_t operand) {
     operand & SIGN ? setBit(SIGN) : clrBit(SIGN);
     operand & OVERFLOW ? setBit(OVERFLOW) : clrBit(OVERFLOW);
     operand & m_a ? clrBit(ZERO) : setBit(ZERO);
     return 0;
 }
 
-uint8_t CPU::BMI() {
-    uint8_t offset = (this->*m_instRom[m_opcode].addr)();
-
+uint8_t CPU::BMI(uint8_t offset) {
     if (m_p & SIGN) {
         if (((m_pc + relativeOffset(offset)) & 0xFF00) != (m_pc & 0xFF00)) {
             m_cycles++;
@@ -461,9 +809,7 @@ uint8_t CPU::BMI() {
     return 0;
 }
 
-uint8_t CPU::BNE() {
-    uint8_t offset = (this->*m_instRom[m_opcode].addr)();
-
+uint8_t CPU::BNE(uint8_t offset) {
     if (!(m_p & ZERO)) {
         if (((m_pc + relativeOffset(offset)) & 0xFF00) != (m_pc & 0xFF00)) {
             m_cycles++;
@@ -476,9 +822,7 @@ uint8_t CPU::BNE() {
     return 0;
 }
 
-uint8_t CPU::BPL() {
-    uint8_t offset = (this->*m_instRom[m_opcode].addr)();
-
+uint8_t CPU::BPL(uint8_t offset) {
     if (!(m_p & SIGN)) {
         if (((m_pc + relativeOffset(offset)) & 0xFF00) != (m_pc & 0xFF00)) {
             m_cycles++;
@@ -502,9 +846,7 @@ uint8_t CPU::BRK() {
     return 0;
 }
 
-uint8_t CPU::BVC() {
-    uint8_t offset = (this->*m_instRom[m_opcode].addr)();
-
+uint8_t CPU::BVC(uint8_t offset) {
     if (!(m_p & OVERFLOW)) {
         if (((m_pc + relativeOffset(offset)) & 0xFF00) != (m_pc & 0xFF00)) {
             m_cycles++;
@@ -517,9 +859,7 @@ uint8_t CPU::BVC() {
     return 0;
 }
 
-uint8_t CPU::BVS() {
-    uint8_t offset = (this->*m_instRom[m_opcode].addr)();
-
+uint8_t CPU::BVS(uint8_t offset) {
     if (m_p & OVERFLOW) {
         if (((m_pc + relativeOffset(offset)) & 0xFF00) != (m_pc & 0xFF00)) {
             m_cycles++;
@@ -537,10 +877,7 @@ uint8_t CPU::CLD() { clrBit(DECIMAL); return 0; }
 uint8_t CPU::CLI() { clrBit(INTERRUPT); return 0; }
 uint8_t CPU::CLV() { clrBit(OVERFLOW); return 0; }
 
-uint8_t CPU::CMP() {
-    /* IMM means use the next byte as an 8-bit value, not an address */
-    uint8_t operand = m_opcode == 0xC9 ? (this->*m_instRom[m_opcode].addr)()
-        : read8((this->*m_instRom[m_opcode].addr)());
+uint8_t CPU::CMP(uint8_t operand) {
     uint16_t diff = static_cast<uint16_t>(m_a) - operand;
 
     m_a >= operand ? setBit(CARRY) : clrBit(CARRY);
@@ -548,10 +885,7 @@ uint8_t CPU::CMP() {
     return 1;
 }
 
-uint8_t CPU::CPX() {
-    /* IMM means use the next byte as an 8-bit value, not an address */
-    uint8_t operand = m_opcode == 0xE0 ? (this->*m_instRom[m_opcode].addr)()
-        : read8((this->*m_instRom[m_opcode].addr)());
+uint8_t CPU::CPX(uint8_t operand) {
     uint16_t diff = static_cast<uint16_t>(m_x) - operand;
 
     m_x >= operand ? setBit(CARRY) : clrBit(CARRY);
@@ -559,10 +893,7 @@ uint8_t CPU::CPX() {
     return 0;
 }
 
-uint8_t CPU::CPY() {
-    /* IMM means use the next byte as an 8-bit value, not an address */
-    uint8_t operand = m_opcode == 0xC0 ? (this->*m_instRom[m_opcode].addr)()
-        : read8((this->*m_instRom[m_opcode].addr)());
+uint8_t CPU::CPY(uint8_t operand) {
     uint16_t diff = static_cast<uint16_t>(m_y) - operand;
 
     m_y >= operand ? setBit(CARRY) : clrBit(CARRY);
@@ -570,8 +901,7 @@ uint8_t CPU::CPY() {
     return 0;
 }
 
-uint8_t CPU::DCP() {
-    uint16_t address = (this->*m_instRom[m_opcode].addr)();
+uint8_t CPU::DCP(uint16_t address) {
     uint8_t operand = read8(address) - 1;
 
     write8(operand, address);
@@ -580,41 +910,23 @@ uint8_t CPU::DCP() {
     return 0;
 }
 
-uint8_t CPU::DEC() {
-    uint16_t address = (this->*m_instRom[m_opcode].addr)();
-    uint8_t value = read8(address) - 1;
-
-    write8(address, value);
-    setZEROSIGN(value);
-    return 0;
-}
-
+uint8_t CPU::DEC(uint8_t& value) { setZEROSIGN(--value); return 0; }
 uint8_t CPU::DEX() { setZEROSIGN(--m_x); return 0; }
 uint8_t CPU::DEY() { setZEROSIGN(--m_y); return 0; }
 uint8_t CPU::DOP() { m_pc++; return 0; }
 
-uint8_t CPU::EOR() {
-    /* Immediate addressing mode returns a value, not an address */
-    m_a ^= m_opcode == 0x49 ? (this->*m_instRom[m_opcode].addr)()
-        : read8((this->*m_instRom[m_opcode].addr)());
+uint8_t CPU::EOR(uint8_t operand) {
+    m_a ^= operand;
     setZEROSIGN(m_a);
     return 1;
 }
 
-uint8_t CPU::INC() {
-    uint16_t address = (this->*m_instRom[m_opcode].addr)();
-    uint8_t value = read8(address) + 1;
-
-    write8(address, value);
-    setZEROSIGN(value);
-    return 0;
-}
-
+uint8_t CPU::INC(uint8_t& value) { setZEROSIGN(++value); return 0; }
 uint8_t CPU::INX() { setZEROSIGN(++m_x); return 0; }
 uint8_t CPU::INY() { setZEROSIGN(++m_y); return 0; }
 
-uint8_t CPU::ISB() {
-    uint8_t address = (this->*m_instRom[m_opcode].addr)();
+uint8_t CPU::ISB(uint16_t effectiveAddress) {
+    uint8_t address = effectiveAddress;
     uint8_t operand = read8(address) + 1;
 
     write8(address, operand);
@@ -646,12 +958,12 @@ uint8_t CPU::ISB() {
     return 0;
 }
 
-uint8_t CPU::JMP() { m_pc = (this->*m_instRom[m_opcode].addr)(); return 0; }
+uint8_t CPU::JMP(uint16_t address) { m_pc = address; return 0; }
 
-uint8_t CPU::JSR() {
-    /* Push address of next instruction + 1 onto the stack in little endian */
-    push16(m_pc + 1);
-    m_pc = (this->*m_instRom[m_opcode].addr)();
+uint8_t CPU::JSR(uint16_t address) {
+    /* Push address of the last byte of this instruction onto the stack in little endian */
+    push16(m_pc - 1);
+    m_pc = address;
     return 0;
 }
 
@@ -660,9 +972,8 @@ uint8_t CPU::JSR() {
  */
 uint8_t CPU::KIL() { m_pc--; return 0; }
 
-uint8_t CPU::LAS() {
-    uint8_t operand = read8((this->*m_instRom[m_opcode].addr)()) & m_s;
-
+uint8_t CPU::LAS(uint8_t operand) {
+    operand &= m_s;
     m_pc--;
     m_a = operand;
     m_x = operand;
@@ -671,60 +982,40 @@ uint8_t CPU::LAS() {
     return 1;
 }
 
-uint8_t CPU::LAX() {
-    uint8_t operand = read8((this->*m_instRom[m_opcode].addr)());
-
+uint8_t CPU::LAX(uint8_t operand) {
     m_a = operand;
     m_x = operand;
     setZEROSIGN(operand);
     return 1;
 }
 
-uint8_t CPU::LDA() {
-    /* IMM addressing means A is loaded with next byte, not MEM[next byte] */
-    m_a = m_opcode == 0xA9 ? (this->*m_instRom[m_opcode].addr)()
-        : read8((this->*m_instRom[m_opcode].addr)());
+uint8_t CPU::LDA(uint8_t operand) {
+    m_a = operand;
     setZEROSIGN(m_a);
     return 1;
 }
 
-uint8_t CPU::LDX() {
-    /* IMM addressing means X is loaded with next byte, not MEM[next byte] */
-    m_x = m_opcode == 0xA2 ? (this->*m_instRom[m_opcode].addr)()
-        : read8((this->*m_instRom[m_opcode].addr)());
+uint8_t CPU::LDX(uint8_t operand) {
+    m_x = operand;
     setZEROSIGN(m_x);
     return 1;
 }
 
-uint8_t CPU::LDY() {
-    /* IMM addressing mode means next byte is the value for Y, not an address */
-    m_y = m_opcode == 0xA0 ? (this->*m_instRom[m_opcode].addr)()
-        : read8((this->*m_instRom[m_opcode].addr)());
+uint8_t CPU::LDY(uint8_t operand) {
+    m_y = operand;
     setZEROSIGN(m_y);
     return 1;
 }
 
-uint8_t CPU::LSR() {
-    /* Different operand if accumulator addressing mode is used */
-    if (m_opcode == 0x4A) {
-        m_a & CARRY ? setBit(CARRY) : clrBit(CARRY);
-        m_a >>= 1;
-        setZEROSIGN(m_a);
-    } else {
-        uint16_t address = (this->*m_instRom[m_opcode].addr)();
-        uint8_t operand = read8(address);
-
-        operand & CARRY ? setBit(CARRY) : clrBit(CARRY);
-        operand >>= 1;
-        setZEROSIGN(operand);
-        write8(address, operand);
-    }
-
+uint8_t CPU::LSR(uint8_t& value) {
+    value & CARRY ? setBit(CARRY) : clrBit(CARRY);
+    value >>= 1;
+    setZEROSIGN(value);
     return 0;
 }
 
-uint8_t CPU::LXA() {
-    m_a &= (this->*m_instRom[m_opcode].addr)();
+uint8_t CPU::LXA(uint8_t operand) {
+    m_a &= operand;
     m_x = m_a;
     setZEROSIGN(m_a);
     return 1;
@@ -732,10 +1023,8 @@ uint8_t CPU::LXA() {
 
 uint8_t CPU::NOP() { return 0; }
 
-uint8_t CPU::ORA() {
-    /* IMM addressing is immediate value, not an address */
-    m_a |= m_opcode == 0x09 ? (this->*m_instRom[m_opcode].addr)()
-        : read8((this->*m_instRom[m_opcode].addr)());
+uint8_t CPU::ORA(uint8_t operand) {
+    m_a |= operand;
     setZEROSIGN(m_a);
     return 1;
 }
@@ -756,77 +1045,41 @@ uint8_t CPU::PLA() {
 
 uint8_t CPU::PLP() { m_p = pop8(); return 0; }
 
-uint8_t CPU::RLA() {
-    uint8_t carry;
-    uint16_t address = (this->*m_instRom[m_opcode].addr)();
-    uint8_t operand = read8(address);
+uint8_t CPU::RLA(uint8_t& value) {
+    uint8_t carry = (m_p & CARRY) >> 7;
 
-    carry = (m_p & CARRY) >> 7;
-    operand & carry ? setBit(CARRY) : clrBit(CARRY);
-    operand = (operand << 1) | carry;
-    write8(address, operand);
-    m_a &= operand;
-    setZEROSIGN(operand);
+    value & carry ? setBit(CARRY) : clrBit(CARRY);
+    value = (value << 1) | carry;
+    m_a &= value;
+    setZEROSIGN(value);
     return 0;
 }
 
-uint8_t CPU::ROL() {
-    /* Different operand if accumulator addressing mode is used */
-    if (m_opcode == 0x2A) {
-        uint8_t carry = m_a & SIGN;
-
-        m_a <<= 1;
-        m_a |= (m_p & CARRY) ? 1 : 0;
-        carry ? setBit(CARRY) : clrBit(CARRY);
-        setZEROSIGN(m_a);
-    } else {
-        uint16_t address = (this->*m_instRom[m_opcode].addr)();
-        uint8_t operand = read8(address);
-        uint8_t carry = operand & SIGN;
-
-        operand <<= 1;
-        operand |= m_p & CARRY;
-        carry ? setBit(CARRY) : clrBit(CARRY);
-        setZEROSIGN(operand);
-        write8(address, operand);
-    }
+uint8_t CPU::ROL(uint8_t& value) {
+    uint8_t carry = value & SIGN;
 
+    value <<= 1;
+    value |= m_p & CARRY;
+    carry ? setBit(CARRY) : clrBit(CARRY);
+    setZEROSIGN(value);
     return 0;
 }
 
-uint8_t CPU::ROR() {
-    /* Accumulator addressing mode means A is the operand */
-    if (m_opcode == 0x6A) {
-        uint8_t carry = m_a & CARRY;
-
-        m_a >>= 1;
-        m_a |= (m_p & CARRY) ? 1 << 7 : 0;
-        carry ? setBit(CARRY) : clrBit(CARRY);
-        setZEROSIGN(m_a);
-    } else {
-        uint16_t address = (this->*m_instRom[m_opcode].addr)();
-        uint8_t operand = read8(address);
-        uint8_t carry = operand & CARRY;
-
-        operand >>= 1;
-        operand |= (m_p & CARRY) ? 1 << 7 : 0;
-        carry ? setBit(CARRY) : clrBit(CARRY);
-        setZEROSIGN(operand);
-        write8(address, operand);
-    }
+uint8_t CPU::ROR(uint8_t& value) {
+    uint8_t carry = value & CARRY;
 
+    value >>= 1;
+    value |= (m_p & CARRY) ? 1 << 7 : 0;
+    carry ? setBit(CARRY) : clrBit(CARRY);
+    setZEROSIGN(value);
     return 0;
 }
 
-uint8_t CPU::RRA() {
-    uint8_t carry;
-    uint16_t address = (this->*m_instRom[m_opcode].addr)();
-    uint8_t operand = read8(address);
+uint8_t CPU::RRA(uint8_t& operand) {
+    uint8_t carry = (m_p & CARRY);
 
-    carry = (m_p & CARRY);
     operand & CARRY ? setBit(CARRY) : clrBit(CARRY);
     operand = (operand >> 1) | carry;
-    write8(address, operand);
 
     if (m_p & DECIMAL) {
         uint8_t al = (m_a & 0x0F) + (operand & 0x0F) + ((m_p & CARRY) ? 1 : 0);
@@ -865,19 +1118,14 @@ uint8_t CPU::RTI() {
 
 uint8_t CPU::RTS() { m_pc = pop16() + 1; return 0; }
 
-uint8_t CPU::SAX() {
-    uint8_t operand = read8((this->*m_instRom[m_opcode].addr)());
+uint8_t CPU::SAX(uint16_t address) {
+    uint8_t operand = read8(address);
 
     write8(operand, m_x & m_a);
     return 0;
 }
 
-uint8_t CPU::SBC() {
-    /* IMM addressing mode means next byte is value, not address */
-    uint8_t operand = m_opcode == 0xE8 || m_opcode == 0xE9
-        ? (this->*m_instRom[m_opcode].addr)()
-        : read8((this->*m_instRom[m_opcode].addr)());
-
+uint8_t CPU::SBC(uint8_t operand) {
     if (m_p & DECIMAL) {
         uint8_t al = (m_a & 0x0F) - (operand & 0x0F) - (1 - ((m_p & CARRY) ? 1 : 0));
         uint8_t ah = (m_a >> 4) - (operand >> 4) - (al < 0 ? 1 : 0);
@@ -906,9 +1154,7 @@ uint8_t CPU::SBC() {
     return 1;
 }
 
-uint8_t CPU::SBX() {
-    uint8_t operand = (this->*m_instRom[m_opcode].addr)();
-
+uint8_t CPU::SBX(uint8_t operand) {
     (m_a & m_x) >= operand ? setBit(CARRY) : clrBit(CARRY);
     m_x = ((m_a & m_x) - operand) & 0xFF;
     setZEROSIGN(m_x);
@@ -919,62 +1165,46 @@ uint8_t CPU::SEC() { setBit(CARRY); return 0; }
 uint8_t CPU::SED() { setBit(DECIMAL); return 0; }
 uint8_t CPU::SEI() { setBit(INTERRUPT); return 0; }
 
-uint8_t CPU::SHA() {
-    uint16_t operand = (this->*m_instRom[m_opcode].addr)();
-
-    write8(m_a & m_x & ((operand >> 8) + 1), operand);
+uint8_t CPU::SHA(uint16_t address) {
+    write8(m_a & m_x & ((address >> 8) + 1), address);
     return 0;
 }
 
-uint8_t CPU::SHS() {
-    uint16_t address = (this->*m_instRom[m_opcode].addr)();
-
+uint8_t CPU::SHS(uint16_t address) {
     m_s = m_a & m_x;
     write8(address, m_a & m_x & ((address >> 8) + 1));
     return 0;
 }
 
-uint8_t CPU::SHX() {
-    uint16_t address = (this->*m_instRom[m_opcode].addr)();
-
+uint8_t CPU::SHX(uint16_t address) {
     write8(address, m_x & ((address >> 8) + 1));
     return 0;
 }
 
-uint8_t CPU::SHY() {
-    uint16_t address = (this->*m_instRom[m_opcode].addr)();
-
+uint8_t CPU::SHY(uint16_t address) {
     write8(address, m_y & ((address >> 8) + 1));
     return 0;
 }
 
-uint8_t CPU::SLO() {
-    uint16_t address = (this->*m_instRom[m_opcode].addr)();
-    uint8_t operand = read8(address);
-
-    operand & CARRY ? setBit(CARRY) : clrBit(CARRY);
-    operand <<= 1;
-    write8(address, operand);
-    m_a |= operand;
+uint8_t CPU::SLO(uint8_t& value) {
+    value & CARRY ? setBit(CARRY) : clrBit(CARRY);
+    value <<= 1;
+    m_a |= value;
     setZEROSIGN(m_a);
     return 0;
 }
 
-uint8_t CPU::SRE() {
-    uint16_t address = (this->*m_instRom[m_opcode].addr)();
-    uint8_t operand = read8(address);
-
-    operand & 0x01 ? setBit(CARRY) : clrBit(CARRY);
-    operand >>= 1;
-    write8(address, operand);
-    m_a ^= operand;
+uint8_t CPU::SRE(uint8_t& value) {
+    value & 0x01 ? setBit(CARRY) : clrBit(CARRY);
+    value >>= 1;
+    m_a ^= value;
     setZEROSIGN(m_a);
     return 0;
 }
 
-uint8_t CPU::STA() { write8((this->*m_instRom[m_opcode].addr)(), m_a); return 0; }
-uint8_t CPU::STX() { write8((this->*m_instRom[m_opcode].addr)(), m_x); return 0; }
-uint8_t CPU::STY() { write8((this->*m_instRom[m_opcode].addr)(), m_y); return 0; }
+uint8_t CPU::STA(uint16_t address) { write8(address, m_a); return 0; }
+uint8_t CPU::STX(uint16_t address) { write8(address, m_x); return 0; }
+uint8_t CPU::STY(uint16_t address) { write8(address, m_y); return 0; }
 
 uint8_t CPU::TAX() {
     m_x = m_a;
@@ -1013,3 +1243,101 @@ uint8_t CPU::TYA() {
     return 0;
 }
 
+/*******************************************************************************
+ *                           Fused instructions                                *
+ ******************************************************************************/
+/**
+ * STA WSYNC: the store every scanline of a kernel ends with, without resolving the address.
+ */
+uint8_t CPU::fuseStaWsync() {
+    m_fusions[FUSE_STA_WSYNC]++;
+    write8(WSYNC, m_a);
+    return 0;
+}
+
+/**
+ * DEX; BNE: countdown loop. The PC already points past the branch, as BNE expects.
+ */
+uint8_t CPU::fuseDexBne() {
+    m_fusions[FUSE_DEX_BNE]++;
+    DEX();
+    return BNE(m_operand);
+}
+
+/**
+ * LDA (zp),Y; STA GRP0: copy a line of a sprite's graphics. The store to the TIA happens after
+ * the load's cycles have elapsed.
+ */
+uint8_t CPU::fuseLdaIdyStaGrp0() {
+    uint8_t additionalCycle = LDA(read8(IDY())) & m_additionalCycle;
+
+    m_fusions[FUSE_LDA_IDY_STA_GRP0]++;
+    m_elapsed = 5 + additionalCycle;
+    write8(GRP0, m_a);
+    m_elapsed = 0;
+    return additionalCycle;
+}
+
+/**
+ * Load INTIM (LDA, LDX, LDY or BIT) and branch on the result: poll the timer until it reaches the
+ * value the game waits for. When the branch goes back to the load, the loop does nothing but wait,
+ * so the polls whose value would still take the branch are skipped: the load happens straight on
+ * the cycle the loop exits on (or the last one the budget allows), and the skipped iterations'
+ * cycles are added to the step's. The timer only changes once an interval, so the polls are
+ * walked an interval at a time rather than one by one.
+ */
+uint8_t CPU::fusePollIntim() {
+    uint8_t branch = m_operand >> 8;
+    uint8_t offset = m_operand & 0xFF;
+
+    m_fusions[FUSE_POLL_INTIM]++;
+
+    if (offset == INTIM_LOOP) {
+        // The branch is taken (and crosses a page if the loop does) on every skipped iteration
+        uint32_t period = 7 + ((m_pc & 0xFF00) != ((m_pc - 5) & 0xFF00));
+        const Timer& timer = m_atari->m_timer;
+        uint64_t start = m_atari->m_cycles;
+
+        // The last poll still has to start its branch within the budget
+        uint64_t limit = (m_budget - 4) / period;
+        uint64_t polls = 0;
+
+        while (polls < limit) {
+            uint64_t cycle = start + polls * period;
+            if (!pollContinues(m_opcode, branch, timer.readIntim(cycle))) {
+                break;
+            }
+            polls += (timer.nextChange(cycle) - cycle + period - 1) / period;
+        }
+
+        m_elapsed = std::min(polls, limit) * period;
+        m_cycles += m_elapsed;
+    }
+
+    uint8_t value = read8(INTIM);
+    switch (m_opcode) {
+        case 0xAD: LDA(value); break;
+        case 0xAE: LDX(value); break;
+        case 0xAC: LDY(value); break;
+        default: BIT(value); break;
+    }
+    m_elapsed = 0;
+
+    m_operand = offset;
+    return (this->*s_instRom[branch].exec)();
+}
+
+/**
+ * @brief Whether the branch is taken after the load polling INTIM reads the given value.
+ */
+bool CPU::pollContinues(uint8_t load, uint8_t branch, uint8_t value) const {
+    bool flag;
+
+    switch (branch >> 6) {
+        case 0: flag = value & SIGN; break;
+        case 1: flag = value & OVERFLOW; break;
+        default: flag = load == 0x2C ? !(value & m_a) : !value; break;
+    }
+
+    return flag == ((branch >> 5) & 0x01);
+}
\ No newline at end of file
@@ -3,15 +3,21 @@
 #include <array>
 #include <cstdint>
 
-#include "Timer.hpp"
-
 #define RESET_VECTOR 0xFFFC
 #define NMI_VECTOR 0xFFFA
 #define IRQ_VECTOR 0xFFFE
 
+// Cartridge ROM window
+#define CART_OFFSET 0xF000
+#define SIZE_CART 4096
+
 class Atari;
 
 class CPU {
+    friend class JIT;
+    friend class Plugin;
+    friend class Recompiled;
+
 public:
     // STATUS REGISTER VALUES
     enum CPUFLAG {
@@ -25,20 +31,83 @@ public:
         CARRY = 0x01
     };
 
+    // MEMORY ADDRESSING MODES
+    enum class AddrMode : uint8_t {
+        ABS, ABX, ABY, ACC, IDX, IDY, IMM, IMP, IND, REL, ZPX, ZPY, ZRP
+    };
+
+    // Where execution continues after an instruction. DOP and TOP skip the bytes following them.
+    enum class Flow : uint8_t {
+        NEXT, BRANCH, JUMP, CALL, RETURN, BREAK, SKIP_BYTE, SKIP_WORD, HALT
+    };
+
+    struct Mnemonic {
+        const char* name;
+        AddrMode mode;
+        Flow flow;
+
+        // Writes to its effective address
+        bool write;
+
+        // Illegal opcode whose effective address is computed from the registers at run time
+        bool dynamic;
+    };
+
+    static const std::array<Mnemonic, 0x100> s_mnemonics;
+
+    // Instruction sequences executed by a single fused handler
+    enum Fusion : uint8_t {
+        FUSE_NONE, FUSE_STA_WSYNC, FUSE_DEX_BNE, FUSE_LDA_IDY_STA_GRP0, FUSE_POLL_INTIM,
+        FUSION_COUNT
+    };
+
+    static const std::array<const char*, FUSION_COUNT> s_fusionNames;
+
+    /**
+     * The registers, as a plain struct to snapshot between steps (see Atari::State). Cycles is
+     * only ever nonzero right after a reset, which charges its cycles to the first step.
+     */
+    struct State {
+        uint32_t cycles;
+        uint16_t pc;
+        uint8_t a;
+        uint8_t x;
+        uint8_t y;
+        uint8_t p;
+        uint8_t s;
+    };
+
     CPU();
     ~CPU();
 
     void connectAtari(Atari* atari);
     void reset();
-    void step();
+    void save(State& state) const;
+    void load(const State& state);
+    uint32_t step(uint32_t budget);
     void nmi();
     void irq();
+    void flushDecodeCache();
+    uint8_t execute(uint8_t opcode, uint16_t operand, uint16_t next);
+    static uint8_t instructionLength(uint8_t opcode);
+    uint32_t instructionEnd() const;
+
+    uint32_t m_cycles = 0;
+
+    // Cycles of the current step already spent by the first part of a fused sequence (or by the
+    // instructions of a translated block before the current one), so that the TIA/RIOT registers
+    // are accessed on the right cycle
+    uint16_t m_elapsed = 0;
 
-    uint8_t m_cycles = 0;
+    // Number of times each fusion has been executed
+    std::array<uint64_t, FUSION_COUNT> m_fusions = {};
 
 private:
     inline void logInfo();
-    inline uint8_t fetch();
+    struct Decoded;
+    inline const Decoded& decode(uint16_t pc);
+    inline void decodeInto(Decoded& inst, uint16_t pc, bool fuse);
+    inline void fuse(Decoded& inst, uint16_t pc);
     inline uint16_t relativeOffset(uint8_t offset) const;
     inline void setBit(CPUFLAG f);
     inline void clrBit(CPUFLAG f);
@@ -52,6 +121,8 @@ private:
     uint16_t pop16();
     void push8(uint8_t data);
     void push16(uint16_t data);
+    inline uint8_t modify(uint16_t address, uint8_t (CPU::*op)(uint8_t&));
+    void dispatch();
 
     // Memory addressing modes
     inline uint16_t ABS(); inline uint16_t ABX(); inline uint16_t ABY();
@@ -60,25 +131,52 @@ private:
     inline uint16_t REL(); inline uint16_t ZPX(); inline uint16_t ZPY();
     inline uint16_t ZRP();
 
-    // Instruction set methods (including illegal opcodes)
-    uint8_t ADC(); uint8_t ANC(); uint8_t AND(); uint8_t ANE(); uint8_t ARR(); uint8_t ASL();
-    uint8_t ASR(); uint8_t BCC(); uint8_t BCS(); uint8_t BEQ(); uint8_t BIT(); uint8_t BMI();
-    uint8_t BNE(); uint8_t BPL(); uint8_t BRK(); uint8_t BVC(); uint8_t BVS(); uint8_t CLC();
-    uint8_t CLD(); uint8_t CLI(); uint8_t CLV(); uint8_t CMP(); uint8_t CPX(); uint8_t CPY();
-    uint8_t DCP(); uint8_t DEC(); uint8_t DEX(); uint8_t DEY(); uint8_t DOP(); uint8_t EOR();
-    uint8_t INC(); uint8_t INX(); uint8_t INY(); uint8_t ISB(); uint8_t JMP(); uint8_t JSR();
-    uint8_t KIL(); uint8_t LAS(); uint8_t LAX(); uint8_t LDA(); uint8_t LDX(); uint8_t LDY();
-    uint8_t LSR(); uint8_t LXA(); uint8_t NOP(); uint8_t ORA(); uint8_t PHA(); uint8_t PHP();
-    uint8_t PLA(); uint8_t PLP(); uint8_t RLA(); uint8_t ROL(); uint8_t ROR(); uint8_t RRA();
-    uint8_t RTI(); uint8_t RTS(); uint8_t SAX(); uint8_t SBC(); uint8_t SBX(); uint8_t SEC();
-    uint8_t SED(); uint8_t SEI(); uint8_t SHA(); uint8_t SHS(); uint8_t SHX(); uint8_t SHY();
-    uint8_t SLO(); uint8_t SRE(); uint8_t STA(); uint8_t STX(); uint8_t STY(); uint8_t TAX();
-    uint8_t TAY(); uint8_t TOP(); uint8_t TSX(); uint8_t TXA(); uint8_t TXS(); uint8_t TYA();
-
-    Timer m_timer;
+    // Instruction handler specialized for an addressing mode and an instruction
+    template <AddrMode M> inline uint16_t resolve();
+    template <AddrMode M> inline uint8_t operand();
+    template <AddrMode M, auto Op> uint8_t exec();
+    template <AddrMode M, auto Op> static constexpr uint8_t length();
+    template <auto Op, auto... Ops> static constexpr bool isAny();
+    template <auto Op> static constexpr Flow flow();
+
+    // Instruction set methods (including illegal opcodes). Instructions which use an addressing
+    // mode take the resolved operand, address, or value to read-modify-write.
+    uint8_t ADC(uint8_t operand); uint8_t ANC(uint8_t operand); uint8_t AND(uint8_t operand);
+    uint8_t ANE(); uint8_t ARR(uint8_t operand); uint8_t ASL(uint8_t& value);
+    uint8_t ASR(uint8_t operand); uint8_t BCC(uint8_t offset); uint8_t BCS(uint8_t offset);
+    uint8_t BEQ(uint8_t offset); uint8_t BIT(uint8_t operand); uint8_t BMI(uint8_t offset);
+    uint8_t BNE(uint8_t offset); uint8_t BPL(uint8_t offset); uint8_t BRK();
+    uint8_t BVC(uint8_t offset); uint8_t BVS(uint8_t offset); uint8_t CLC(); uint8_t CLD();
+    uint8_t CLI(); uint8_t CLV(); uint8_t CMP(uint8_t operand); uint8_t CPX(uint8_t operand);
+    uint8_t CPY(uint8_t operand); uint8_t DCP(uint16_t address); uint8_t DEC(uint8_t& value);
+    uint8_t DEX(); uint8_t DEY(); uint8_t DOP(); uint8_t EOR(uint8_t operand);
+    uint8_t INC(uint8_t& value); uint8_t INX(); uint8_t INY();
+    uint8_t ISB(uint16_t effectiveAddress);
+    uint8_t JMP(uint16_t address); uint8_t JSR(uint16_t address); uint8_t KIL();
+    uint8_t LAS(uint8_t operand); uint8_t LAX(uint8_t operand); uint8_t LDA(uint8_t operand);
+    uint8_t LDX(uint8_t operand); uint8_t LDY(uint8_t operand); uint8_t LSR(uint8_t& value);
+    uint8_t LXA(uint8_t operand); uint8_t NOP(); uint8_t ORA(uint8_t operand); uint8_t PHA();
+    uint8_t PHP(); uint8_t PLA(); uint8_t PLP(); uint8_t RLA(uint8_t& value);
+    uint8_t ROL(uint8_t& value); uint8_t ROR(uint8_t& value); uint8_t RRA(uint8_t& operand);
+    uint8_t RTI(); uint8_t RTS(); uint8_t SAX(uint16_t address); uint8_t SBC(uint8_t operand);
+    uint8_t SBX(uint8_t operand); uint8_t SEC(); uint8_t SED(); uint8_t SEI();
+    uint8_t SHA(uint16_t address); uint8_t SHS(uint16_t address); uint8_t SHX(uint16_t address);
+    uint8_t SHY(uint16_t address); uint8_t SLO(uint8_t& value); uint8_t SRE(uint8_t& value);
+    uint8_t STA(uint16_t address); uint8_t STX(uint16_t address); uint8_t STY(uint16_t address);
+    uint8_t TAX(); uint8_t TAY(); uint8_t TOP(); uint8_t TSX(); uint8_t TXA(); uint8_t TXS();
+    uint8_t TYA();
+
+    // Fused handlers of common instruction sequences
+    uint8_t fuseStaWsync(); uint8_t fuseDexBne(); uint8_t fuseLdaIdyStaGrp0();
+    uint8_t fusePollIntim();
+    bool pollContinues(uint8_t load, uint8_t branch, uint8_t value) const;
+
     Atari* m_atari = nullptr;
     uint8_t m_additionalCycle = 0;
 
+    // Cycles the current step may run ahead of the rest of the system (see step())
+    uint32_t m_budget = 0;
+
     // Accumulator register A
     uint8_t m_a = 0x00;
 
@@ -98,13 +196,35 @@ private:
     // Current opcode
     uint8_t m_opcode = 0x00;
 
+    // Bytes following the current opcode, fetched when the instruction was decoded
+    uint16_t m_operand = 0x0000;
+
     struct Instruction {
-        std::string name;
-        uint8_t (CPU::*op)(void);
-        uint16_t (CPU::*addr)(void);
+        uint8_t (CPU::*exec)(void);
         uint8_t cycles;
+        uint8_t length;
     };
 
-    std::array<Instruction, 0x100> m_instRom;
+    static const std::array<Instruction, 0x100> s_instRom;
+
+    // An instruction decoded ahead of time: everything needed to execute it without fetching.
+    // It may instead be a fused sequence of instructions, in which case split is the most cycles
+    // the first instruction can take.
+    struct Decoded {
+        uint8_t (CPU::*exec)(void) = nullptr;
+        uint16_t operand = 0x0000;
+        uint8_t opcode = 0x00;
+        uint8_t cycles = 0;
+        uint8_t length = 0;
+        uint8_t fusion = FUSE_NONE;
+        uint8_t split = 0;
+    };
+
+    // Decoded instructions of the cartridge ROM, indexed by the PC's offset into the cartridge
+    // (whichever mirror it runs at). An entry with a null handler has not been decoded yet.
+    std::array<Decoded, SIZE_CART> m_decodeCache;
+
+    // Scratch entry for instructions executed from outside the cartridge, such as RIOT RAM
+    Decoded m_uncached;
 };
 
@@ -0,0 +1,207 @@
+/*
+ *                                 $$ $$$$$ $$
+ *                                 $$ $$$$$ $$
+ *                                .$$ $$$$$ $$.
+ *                                :$$ $$$$$ $$:
+ *                                $$$ $$$$$ $$$
+ *                                $$$ $$$$$ $$$
+ *                               ,$$$ $$$$$ $$$.
+ *                              ,$$$$ $$$$$ $$$$.
+ *                             ,$$$$; $$$$$ :$$$$.
+ *                            ,$$$$$  $$$$$  $$$$$.
+ *                          ,$$$$$$'  $$$$$  `$$$$$$.
+ *                        ,$$$$$$$'   $$$$$   `$$$$$$$.
+ *                     ,s$$$$$$$'     $$$$$     `$$$$$$$s.
+ *                   $$$$$$$$$'       $$$$$       `$$$$$$$$$
+ *                   $$$$$Y'          $$$$$          `Y$$$$$
+ *
+ *
+ * Headless.cpp: frontend which runs a ROM for a number of frames without a window, keyboard or
+ * audio device, for servers and scripts. It prints how fast the emulation ran and a hash of every
+ * frame drawn, so that runs can be compared without looking at them, and can record the sound.
+ *
+ * Frames run as fast as they can, unless --realtime paces them like the windowed frontend: by
+ * the sound a NullAudioDevice has played, or by the monotonic clock with --mute. It then reports
+ * the latencies the pacer measured.
+ *
+ * Usage: atari2600-headless [--jit] [--aot PLUGIN_DIRECTORY] [--wav FILE] [--frames N]
+ *     [--realtime [--mute]] ROM
+ */
+#include <array>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include "Atari.hpp"
+#include "NullAudioDevice.hpp"
+#include "Pacer.hpp"
+#include "Resampler.hpp"
+#include "WavSink.hpp"
+
+// Frames run unless --frames says otherwise, a minute's worth
+#define DEFAULT_FRAMES 3600
+
+// Sample rate the sound is recorded and played at
+#define OUTPUT_RATE 48000
+
+// How long --realtime sleeps while no frame is due, in microseconds
+#define REALTIME_SLEEP 1000
+
+// 64-bit FNV-1a
+#define FNV_OFFSET 0xCBF29CE484222325
+#define FNV_PRIME 0x100000001B3
+
+/**
+ * Hashes every frame presented into one running hash, from the palette indices since colors
+ * don't add anything to compare.
+ */
+class FrameHash : public VideoSink {
+public:
+    void presentFrame(const uint8_t* frame) override {
+        for (size_t i = 0; i < WIDTH * HEIGHT; i++) {
+            m_hash = (m_hash ^ frame[i]) * FNV_PRIME;
+        }
+    }
+
+    uint64_t m_hash = FNV_OFFSET;
+};
+
+/**
+ * Nobody at the controls: nothing pressed, and the console switches left alone.
+ */
+class IdleInput : public InputSource {
+public:
+    Inputs poll() override {
+        return Inputs();
+    }
+};
+
+int main(int argc, char* argv[]) {
+    std::string romPath;
+    std::string pluginPath;
+    std::string wavPath;
+    uint64_t frames = DEFAULT_FRAMES;
+    bool jit = false;
+    bool realtime = false;
+    bool mute = false;
+
+    for (int i = 1; i < argc; i++) {
+        if (std::string(argv[i]) == "--jit") {
+            jit = true;
+        } else if (std::string(argv[i]) == "--aot" && i + 1 < argc) {
+            pluginPath = argv[++i];
+        } else if (std::string(argv[i]) == "--wav" && i + 1 < argc) {
+            wavPath = argv[++i];
+        } else if (std::string(argv[i]) == "--frames" && i + 1 < argc) {
+            frames = std::stoull(argv[++i]);
+        } else if (std::string(argv[i]) == "--realtime") {
+            realtime = true;
+        } else if (std::string(argv[i]) == "--mute") {
+            mute = true;
+        } else {
+            romPath = argv[i];
+        }
+    }
+
+    if (romPath.empty()) {
+        std::cout << "Usage: " << argv[0]
+            << " [--jit] [--aot PLUGIN_DIRECTORY] [--wav FILE] [--frames N]"
+            << " [--realtime [--mute]] ROM" << std::endl;
+        return 1;
+    }
+
+    Atari atari;
+    std::ifstream ifs(romPath, std::ifstream::binary);
+
+    if (!ifs.read((char*) atari.m_rom.data(), SIZE_CART)) {
+        std::cout << "Error reading file" << std::endl;
+        return 1;
+    }
+
+    FrameHash video;
+    IdleInput input;
+    atari.reset();
+    atari.connectInput(&input);
+    atari.m_tia.connectVideo(&video);
+    atari.m_jit.setEnabled(jit);
+    if (!pluginPath.empty() && atari.m_plugin.load(pluginPath)) {
+        std::cout << "Running recompiled ROM from " << pluginPath << std::endl;
+    }
+
+    WavSink wav;
+    Resampler resampler;
+    std::array<float, AUDIO_BUFFER> samples;
+    std::array<float, 2 * AUDIO_BUFFER> output;
+    if (!wavPath.empty() && !wav.open(wavPath, OUTPUT_RATE)) {
+        std::cout << "Error creating " << wavPath << std::endl;
+    }
+    resampler.configure(AUDIO_RATE, OUTPUT_RATE, Resampler::Quality::HIGH);
+
+    // Seconds the emulated console has run for
+    auto emulatedTime = [&atari]() { return atari.m_tia.m_clocks / COLOR_CLOCK; };
+
+    NullAudioDevice device;
+    Pacer pacer;
+    bool playing = realtime && !mute;
+    if (playing) {
+        device.open(OUTPUT_RATE);
+    }
+    pacer.reset(emulatedTime());
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (uint64_t frame = 0; frame < frames;) {
+        if (playing) {
+            device.update();
+            pacer.reportAudio(OUTPUT_RATE, device.m_played, device.queued());
+        }
+        if (realtime && !pacer.frameDue(emulatedTime())) {
+            std::this_thread::sleep_for(std::chrono::microseconds(REALTIME_SLEEP));
+            continue;
+        }
+
+        atari.pollInputs();
+        pacer.inputsPolled();
+
+        do {
+            atari.step();
+        } while (!atari.m_tia.m_frameDone);
+
+        // The frame has been hashed, which is as far as presenting it goes here
+        atari.m_tia.m_frameDone = false;
+        pacer.framePresented();
+        frame++;
+
+        size_t count = atari.m_tia.m_audio.m_samples.pop(samples.data(), samples.size());
+        if (playing) {
+            resampler.setRatio(AUDIO_RATE / OUTPUT_RATE * pacer.getRateAdjustment());
+        }
+        count = resampler.process(samples.data(), count, output.data(), output.size());
+        device.write(output.data(), count);
+        wav.write(output.data(), count);
+    }
+
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    const TIA::FrameStats& stats = atari.m_tia.m_frameStats;
+    std::cout << "Frames: " << stats.frames << " (" << stats.watchdogFrames
+        << " ended by the watchdog), " << stats.minScanlines << "-" << stats.maxScanlines
+        << " scanlines" << std::endl;
+    std::cout << "Time: " << elapsed.count() << " s, " << frames / elapsed.count() << " fps"
+        << std::endl;
+    std::cout << "Frame hash: " << std::hex << video.m_hash << std::dec << std::endl;
+    if (realtime) {
+        const Pacer::Metrics& metrics = pacer.m_metrics;
+        std::cout << "Input to present: " << metrics.inputToPresent * 1000 << " ms (max "
+            << metrics.maxInputToPresent * 1000 << " ms), " << metrics.resyncs << " resyncs"
+            << std::endl;
+    }
+    if (playing) {
+        std::cout << "Audio latency: " << pacer.m_metrics.audioLatency * 1000 << " ms, "
+            << device.m_underrun * 1000.0 / OUTPUT_RATE << " ms of underruns, "
+            << device.m_overrun * 1000.0 / OUTPUT_RATE << " ms of overruns" << std::endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Where the machine reads its controllers and console switches from (see Atari::connectInput()),
+ * such as a keyboard or a recorded session.
+ */
+class InputSource {
+public:
+    /**
+     * The inputs as the registers they're read from hold them, a cleared bit being a switch
+     * pressed or a direction held. The defaults have nothing pressed.
+     */
+    struct Inputs {
+        // SWCHA: right, left, down and up of the left joystick in the upper nibble, of the right
+        // one in the lower nibble
+        uint8_t joysticks = 0xFF;
+
+        // SWCHB: reset, select, color, and the difficulty of either player
+        uint8_t switches = 0xFF;
+
+        // INPT4 and INPT5: the joysticks' buttons, in bit 7
+        uint8_t button0 = 0x80;
+        uint8_t button1 = 0x80;
+    };
+
+    virtual ~InputSource() = default;
+
+    virtual Inputs poll() = 0;
+};
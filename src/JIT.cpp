@@ -0,0 +1,525 @@
+/**
+ *                                 $$ $$$$$ $$
+ *                                 $$ $$$$$ $$
+ *                                .$$ $$$$$ $$.
+ *                                :$$ $$$$$ $$:
+ *                                $$$ $$$$$ $$$
+ *                                $$$ $$$$$ $$$
+ *                               ,$$$ $$$$$ $$$.
+ *                              ,$$$$ $$$$$ $$$$.
+ *                             ,$$$$; $$$$$ :$$$$.
+ *                            ,$$$$$  $$$$$  $$$$$.
+ *                          ,$$$$$$'  $$$$$  `$$$$$$.
+ *                        ,$$$$$$$'   $$$$$   `$$$$$$$.
+ *                     ,s$$$$$$$'     $$$$$     `$$$$$$$s.
+ *                   $$$$$$$$$'       $$$$$       `$$$$$$$$$
+ *                   $$$$$Y'          $$$$$          `Y$$$$$
+ *
+ * JIT.cpp: optional dynamic recompiler which translates hot basic blocks of the cartridge ROM into
+ * x86-64 machine code.
+ *
+ * A block is a straight run of instructions ending at the first branch, jump, return, or at the
+ * first instruction which might touch a TIA/RIOT register (or write into the cartridge). Those
+ * instructions are left to the interpreter, so the TIA and timer are hardly ever synchronized in
+ * the middle of a block and the cycle count at the block exit is exactly the interpreter's. The
+ * exception is the stack, which kernels sometimes point at the TIA's mirror at 0x100; handlers
+ * are therefore told how many cycles of the block have elapsed before them (see CPU::m_elapsed).
+ *
+ * Simple instructions are emitted as native code working directly on the CPU registers and RAM;
+ * everything else becomes a call into the instruction's handler of the interpreter, which keeps
+ * illegal opcodes, decimal mode, and the CPU's quirks identical between both.
+ */
+#include <cstring>
+#include <utility>
+
+#if defined(__x86_64__) && defined(__unix__)
+#define JIT_SUPPORTED
+#include <sys/mman.h>
+#endif
+
+#include "Atari.hpp"
+#include "JIT.hpp"
+
+// Executions of a block start address before it gets translated
+#define HOT_THRESHOLD 16
+
+// Longest block translated, in instructions
+#define MAX_BLOCK 32
+
+// Size of the code buffer; when it runs full every block is thrown away
+#define SIZE_CODE (1 << 20)
+
+// x86-64 registers used by the translated code
+#define EAX 0
+#define ECX 1
+#define EDX 2
+
+JIT::JIT() = default;
+
+JIT::~JIT() {
+#ifdef JIT_SUPPORTED
+    if (m_code) {
+        munmap(m_code, m_codeSize);
+    }
+#endif
+}
+
+void JIT::connectAtari(Atari* atari) {
+    m_atari = atari;
+    m_cpu = &atari->m_cpu;
+
+    auto offset = [this](const void* reg) {
+        return static_cast<uint32_t>(static_cast<const uint8_t*>(reg)
+            - reinterpret_cast<const uint8_t*>(m_cpu));
+    };
+
+    m_offA = offset(&m_cpu->m_a);
+    m_offX = offset(&m_cpu->m_x);
+    m_offY = offset(&m_cpu->m_y);
+    m_offP = offset(&m_cpu->m_p);
+    m_offS = offset(&m_cpu->m_s);
+    m_offPC = offset(&m_cpu->m_pc);
+    m_offOpcode = offset(&m_cpu->m_opcode);
+    m_offOperand = offset(&m_cpu->m_operand);
+    m_offAdditionalCycle = offset(&m_cpu->m_additionalCycle);
+    m_offElapsed = offset(&m_cpu->m_elapsed);
+}
+
+/**
+ * @brief Turn the recompiler on or off. It stays off on hosts other than x86-64 or when no
+ * executable memory can be mapped.
+ */
+void JIT::setEnabled(bool enabled) {
+    m_enabled = false;
+#ifdef JIT_SUPPORTED
+    if (enabled && !m_code) {
+        void* code = mmap(nullptr, SIZE_CODE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS,
+            -1, 0);
+
+        if (code != MAP_FAILED && mprotect(code, SIZE_CODE, PROT_READ | PROT_EXEC) == 0) {
+            m_code = static_cast<uint8_t*>(code);
+            m_codeSize = SIZE_CODE;
+        } else if (code != MAP_FAILED) {
+            munmap(code, SIZE_CODE);
+        }
+    }
+
+    m_enabled = enabled && m_code;
+#endif
+    flush();
+}
+
+/**
+ * Run the translated block starting at the CPU's PC, translating it first once it became hot.
+ * Nothing is run if the block may not finish within the given budget: the number of CPU cycles
+ * the last instruction of the block may start at without the TIA having to catch up first.
+ * @return Number of CPU cycles consumed, or 0 if the interpreter has to execute the next
+ * instruction instead
+ */
+uint32_t JIT::run(uint32_t budget) {
+    uint16_t pc = m_cpu->m_pc;
+
+    if (m_cpu->m_cycles) {
+        return 0;
+    }
+
+    if (Atari::isCart(pc)) {
+        Block& block = m_blocks[pc & (SIZE_CART - 1)];
+
+        if (!block.code && !block.untranslatable && ++block.heat >= HOT_THRESHOLD) {
+            translate(pc, block);
+        }
+
+        if (block.code && block.maxStartCycles <= budget) {
+            uint32_t cycles = block.code(m_cpu);
+
+            // Taken branches count their extra cycles on the CPU itself
+            cycles += m_cpu->m_cycles;
+            m_cpu->m_cycles = 0;
+            m_translated += block.instructions;
+            return cycles;
+        }
+    }
+
+    m_interpreted++;
+    return 0;
+}
+
+/**
+ * @brief Throw away every translated block. Has to be called whenever the contents of the
+ * cartridge window change, e.g. when a ROM is loaded or a bank is switched in.
+ */
+void JIT::flush() {
+    m_blocks.fill(Block{});
+    m_codeUsed = 0;
+}
+
+/**
+ * Collect the instructions of the block starting at the given address of the cartridge ROM, at
+ * any of the cartridge's mirrors. A block ends with the cartridge, so it is the same whichever
+ * mirror it is entered through. These rules are shared with the static recompiler, so both run
+ * exactly the same blocks.
+ * @return false if not even the first instruction can be translated
+ */
+bool JIT::scan(const uint8_t* rom, uint16_t pc, std::vector<Op>& ops) {
+    uint32_t offset = pc & (SIZE_CART - 1);
+
+    while (ops.size() < MAX_BLOCK && Atari::isCart(pc) && offset < SIZE_CART) {
+        const uint8_t* bytes = rom + offset;
+        uint8_t opcode = bytes[0];
+        uint8_t length = CPU::s_instRom[opcode].length;
+        const CPU::Mnemonic& mnemonic = CPU::s_mnemonics[opcode];
+
+        if (offset + length > SIZE_CART) {
+            break;
+        }
+
+        uint16_t operand = 0x0000;
+        if (length == 2) {
+            operand = bytes[1];
+        } else if (length == 3) {
+            operand = bytes[1] | (bytes[2] << 8);
+        }
+
+        bool jump = mnemonic.flow == CPU::Flow::JUMP || mnemonic.flow == CPU::Flow::CALL;
+        bool terminal = mnemonic.flow != CPU::Flow::NEXT;
+
+        // Range of data addresses the instruction may access
+        uint32_t lo = 0, hi = 0;
+        bool memory = length > 1 && mnemonic.mode != CPU::AddrMode::IMM
+            && mnemonic.mode != CPU::AddrMode::REL
+            && !(jump && mnemonic.mode == CPU::AddrMode::ABS);
+
+        switch (mnemonic.mode) {
+            case CPU::AddrMode::IDX: case CPU::AddrMode::IDY: case CPU::AddrMode::IND:
+            case CPU::AddrMode::ZPY:
+                // Address only known at run time
+                lo = 0;
+                hi = 0xFFFF;
+                break;
+            case CPU::AddrMode::ZPX: case CPU::AddrMode::ABX: case CPU::AddrMode::ABY:
+                lo = operand;
+                hi = operand + 0xFF;
+                break;
+            default:
+                lo = hi = operand;
+                break;
+        }
+
+        bool unknown = mnemonic.dynamic || mnemonic.flow == CPU::Flow::HALT;
+        bool write = mnemonic.write;
+
+        // Every page in the range has to be plain memory
+        bool plain = hi <= 0xFFFF;
+        for (uint32_t page = lo & ~(SIZE_PAGE - 1); memory && plain && page <= hi;
+                page += SIZE_PAGE) {
+            plain = Atari::isMemory(page, write);
+        }
+
+        if (unknown || (memory && !plain)) {
+            break;
+        }
+
+        ops.push_back({ pc, operand, opcode, length, CPU::s_instRom[opcode].cycles });
+        if (terminal) {
+            break;
+        }
+
+        pc += length;
+        offset += length;
+    }
+
+    return !ops.empty();
+}
+
+/**
+ * Translate the block starting at the given address. The generated function takes the CPU, runs
+ * the block, leaves the PC at the instruction following it, and returns the cycles consumed
+ * (except for the extra cycles of a taken branch, which the branch handler adds to the CPU). The
+ * PC is only ever moved relative to where the block was entered, so the same code runs at every
+ * mirror of the cartridge.
+ */
+void JIT::translate(uint16_t pc, Block& block) {
+    std::vector<Op> ops;
+
+    if (!m_enabled || !scan(m_atari->m_rom.data(), pc, ops)) {
+        block.untranslatable = true;
+        return;
+    }
+
+    // Worst case: every instruction calls its handler
+    if (m_codeSize - m_codeUsed < 64 + ops.size() * 80) {
+        flush();
+    }
+
+    // The buffer is never writable and executable at the same time
+    if (!setWritable(true)) {
+        block.untranslatable = true;
+        return;
+    }
+
+    uint8_t* start = m_code + m_codeUsed;
+    uint32_t cycles = 0;
+    m_emit = start;
+    m_emitPC = pc;
+
+    // push rbx; push r12; push r13; mov rbx, rdi; xor r12d, r12d; mov r13, &m_ram
+    emit8(0x53); emit8(0x41); emit8(0x54); emit8(0x41); emit8(0x55);
+    emit8(0x48); emit8(0x89); emit8(0xFB);
+    emit8(0x45); emit8(0x31); emit8(0xE4);
+    emit8(0x49); emit8(0xBD); emit64(reinterpret_cast<uint64_t>(m_atari->m_ram.data()));
+
+    bool native = false;
+    block.maxStartCycles = 0;
+    for (size_t i = 0; i < ops.size(); i++) {
+        const Op& op = ops[i];
+        uint8_t maxCycles = op.cycles;
+
+        native = emitNative(op, cycles);
+        if (!native) {
+            emitCall(op, cycles);
+            cycles += op.cycles;
+            maxCycles += CPU::s_mnemonics[op.opcode].mode == CPU::AddrMode::REL ? 2 : 1;
+        }
+
+        if (i + 1 < ops.size()) {
+            block.maxStartCycles += maxCycles;
+        }
+    }
+
+    // Handlers leave the PC after their instruction (or at the jump target), native code doesn't
+    if (native) {
+        const Op& last = ops.back();
+
+        emitMovePC(last.pc + last.length);
+    }
+
+    // mov word [rbx + elapsed], 0
+    emit8(0x66); emit8(0xC7); emitModRM(0, m_offElapsed); emit16(0);
+
+    // lea eax, [r12 + cycles]; pop r13; pop r12; pop rbx; ret
+    emit8(0x41); emit8(0x8D); emit8(0x84); emit8(0x24); emit32(cycles);
+    emit8(0x41); emit8(0x5D); emit8(0x41); emit8(0x5C); emit8(0x5B); emit8(0xC3);
+
+    m_codeUsed += m_emit - start;
+    if (!setWritable(false)) {
+        // Not executable, so nothing in the buffer may run any more
+        m_enabled = false;
+        flush();
+        return;
+    }
+
+    block.code = reinterpret_cast<BlockCode>(start);
+    block.instructions = ops.size();
+    m_blocksTranslated++;
+}
+
+/**
+ * @brief Switch the code buffer between writable, while a block is emitted, and executable.
+ * @return false if the protection could not be changed
+ */
+bool JIT::setWritable(bool writable) {
+#ifdef JIT_SUPPORTED
+    return mprotect(m_code, m_codeSize, writable ? PROT_READ | PROT_WRITE
+        : PROT_READ | PROT_EXEC) == 0;
+#else
+    return !writable;
+#endif
+}
+
+/**
+ * Emit the given instruction as native code if it is one of the simple, frequent instructions
+ * which only move data between registers and RAM.
+ * @return false if the instruction has to call its handler instead
+ */
+bool JIT::emitNative(const Op& op, uint32_t& cycles) {
+    uint32_t src = 0, dst = 0;
+    bool flags = true;
+
+    switch (op.opcode) {
+        case 0xAA: src = m_offA; dst = m_offX; break;                   // TAX
+        case 0xA8: src = m_offA; dst = m_offY; break;                   // TAY
+        case 0x8A: src = m_offX; dst = m_offA; break;                   // TXA
+        case 0x98: src = m_offY; dst = m_offA; break;                   // TYA
+        case 0xBA: src = m_offS; dst = m_offX; break;                   // TSX
+        case 0x9A: src = m_offX; dst = m_offS; flags = false; break;    // TXS
+        case 0xE8: case 0xC8: case 0xCA: case 0x88:                     // INX, INY, DEX, DEY
+            dst = (op.opcode == 0xE8 || op.opcode == 0xCA) ? m_offX : m_offY;
+            emitMovzxCpu(EAX, dst);
+            // inc al / dec al
+            emit8(0xFE); emit8(op.opcode == 0xE8 || op.opcode == 0xC8 ? 0xC0 : 0xC8);
+            emitStoreCpu(EAX, dst);
+            emitZeroSign();
+            cycles += op.cycles;
+            return true;
+        case 0x18: case 0x38: case 0xD8: case 0xF8: case 0x58: case 0x78: case 0xB8: {
+            // CLC, SEC, CLD, SED, CLI, SEI, CLV
+            static const std::array<uint8_t, 8> bits = {
+                CPU::CARRY, CPU::CARRY, CPU::INTERRUPT, CPU::INTERRUPT, 0, CPU::OVERFLOW,
+                CPU::DECIMAL, CPU::DECIMAL
+            };
+            uint8_t bit = bits[op.opcode >> 5];
+            bool set = op.opcode == 0x38 || op.opcode == 0xF8 || op.opcode == 0x78;
+
+            // or byte [rbx + p], bit / and byte [rbx + p], ~bit
+            emit8(0x80); emitModRM(set ? 1 : 4, m_offP); emit8(set ? bit : ~bit);
+            cycles += op.cycles;
+            return true;
+        }
+        case 0xEA:                                                      // NOP
+            cycles += op.cycles;
+            return true;
+        case 0xA9: case 0xA2: case 0xA0:                                // LDA, LDX, LDY #imm
+            dst = op.opcode == 0xA9 ? m_offA : op.opcode == 0xA2 ? m_offX : m_offY;
+            // mov eax, imm
+            emit8(0xB8); emit32(op.operand);
+            emitStoreCpu(EAX, dst);
+            emitZeroSign();
+            cycles += op.cycles;
+            return true;
+        case 0xA5: case 0xA6: case 0xA4: case 0xAD: case 0xAE: case 0xAC:
+            // LDA, LDX, LDY from zero page or absolute; scan() made sure it's no register, but it
+            // may still be the cartridge, which is left to the handler
+            if (!Atari::isRam(op.operand)) {
+                return false;
+            }
+            dst = (op.opcode & 0x03) == 0x01 ? m_offA
+                : (op.opcode & 0x03) == 0x02 ? m_offX : m_offY;
+            // movzx eax, byte [r13 + address]
+            emit8(0x41); emit8(0x0F); emit8(0xB6); emit8(0x85); emit32(op.operand & (SIZE_RAM - 1));
+            emitStoreCpu(EAX, dst);
+            emitZeroSign();
+            cycles += op.cycles;
+            return true;
+        case 0x85: case 0x86: case 0x84: case 0x8D: case 0x8E: case 0x8C:
+            // STA, STX, STY to zero page or absolute; scan() made sure it's RAM
+            src = (op.opcode & 0x03) == 0x01 ? m_offA
+                : (op.opcode & 0x03) == 0x02 ? m_offX : m_offY;
+            emitMovzxCpu(EAX, src);
+            // mov byte [r13 + address], al
+            emit8(0x41); emit8(0x88); emit8(0x85); emit32(op.operand & (SIZE_RAM - 1));
+            cycles += op.cycles;
+            return true;
+        default:
+            return false;
+    }
+
+    // Register transfers
+    emitMovzxCpu(EAX, src);
+    emitStoreCpu(EAX, dst);
+    if (flags) {
+        emitZeroSign();
+    }
+
+    cycles += op.cycles;
+    return true;
+}
+
+/**
+ * @brief Plain function calling the handler of the given opcode, so translated code can call it.
+ */
+template <uint8_t Opcode>
+uint8_t JIT::thunk(CPU* cpu) {
+    return (cpu->*CPU::s_instRom[Opcode].exec)();
+}
+
+template <size_t... Opcodes>
+constexpr std::array<uint8_t (*)(CPU*), 0x100> JIT::thunks(std::index_sequence<Opcodes...>) {
+    return {{ &JIT::thunk<Opcodes>... }};
+}
+
+/**
+ * Emit a call to the instruction's handler, with the CPU set up as the interpreter would: the PC
+ * after the instruction, the decoded operand, and the additional cycle flag cleared. The cycles of
+ * the block spent so far are stored as elapsed, and the extra cycle the handler may report is
+ * added to the cycles counted in r12d.
+ */
+void JIT::emitCall(const Op& op, uint32_t cycles) {
+    // lea eax, [r12 + cycles]; mov word [rbx + elapsed], ax
+    emit8(0x41); emit8(0x8D); emit8(0x84); emit8(0x24); emit32(cycles);
+    emit8(0x66); emit8(0x89); emitModRM(EAX, m_offElapsed);
+
+    // mov word [rbx + operand], operand
+    emitMovePC(op.pc + op.length);
+    emit8(0x66); emit8(0xC7); emitModRM(0, m_offOperand); emit16(op.operand);
+
+    // mov byte [rbx + opcode], opcode; mov byte [rbx + additionalCycle], 0
+    emit8(0xC6); emitModRM(0, m_offOpcode); emit8(op.opcode);
+    emit8(0xC6); emitModRM(0, m_offAdditionalCycle); emit8(0x00);
+
+    // mov rdi, rbx; mov rax, handler; call rax
+    static constexpr std::array<uint8_t (*)(CPU*), 0x100> handlers =
+        thunks(std::make_index_sequence<0x100>{});
+    emit8(0x48); emit8(0x89); emit8(0xDF);
+    emit8(0x48); emit8(0xB8); emit64(reinterpret_cast<uint64_t>(handlers[op.opcode]));
+    emit8(0xFF); emit8(0xD0);
+
+    // and al, [rbx + additionalCycle]; movzx eax, al; add r12d, eax
+    emit8(0x22); emitModRM(EAX, m_offAdditionalCycle);
+    emit8(0x0F); emit8(0xB6); emit8(0xC0);
+    emit8(0x41); emit8(0x01); emit8(0xC4);
+}
+
+/**
+ * @brief Emit the code moving the CPU's PC to the given address of the block being translated.
+ * Non-terminal handlers leave the PC where it was set before calling them, so the distance from
+ * the PC the code has already set is known.
+ */
+void JIT::emitMovePC(uint16_t pc) {
+    uint16_t distance = pc - m_emitPC;
+
+    // add word [rbx + pc], distance
+    if (distance) {
+        emit8(0x66); emit8(0x81); emitModRM(0, m_offPC); emit16(distance);
+    }
+
+    m_emitPC = pc;
+}
+
+/**
+ * @brief Emit the equivalent of CPU::setZEROSIGN() for the value in al (zero extended in eax).
+ */
+void JIT::emitZeroSign() {
+    // movzx ecx, byte [rbx + p]; and ecx, ~(ZERO | SIGN)
+    emitMovzxCpu(ECX, m_offP);
+    emit8(0x83); emit8(0xE1); emit8(static_cast<uint8_t>(~(CPU::ZERO | CPU::SIGN)));
+
+    // mov edx, eax; and edx, SIGN; or ecx, edx
+    emit8(0x89); emit8(0xC2);
+    emit8(0x81); emit8(0xE2); emit32(CPU::SIGN);
+    emit8(0x09); emit8(0xD1);
+
+    // test al, al; jnz +3; or ecx, ZERO
+    emit8(0x84); emit8(0xC0);
+    emit8(0x75); emit8(0x03);
+    emit8(0x83); emit8(0xC9); emit8(CPU::ZERO);
+
+    emitStoreCpu(ECX, m_offP);
+}
+
+void JIT::emit8(uint8_t byte) { *m_emit++ = byte; }
+void JIT::emit16(uint16_t value) { memcpy(m_emit, &value, 2); m_emit += 2; }
+void JIT::emit32(uint32_t value) { memcpy(m_emit, &value, 4); m_emit += 4; }
+void JIT::emit64(uint64_t value) { memcpy(m_emit, &value, 8); m_emit += 8; }
+
+/**
+ * @brief Emit the ModRM byte and displacement addressing [rbx + disp] with the given reg field.
+ */
+void JIT::emitModRM(uint8_t reg, uint32_t disp) {
+    emit8(0x83 | (reg << 3));
+    emit32(disp);
+}
+
+/**
+ * @brief movzx reg, byte [rbx + disp]
+ */
+void JIT::emitMovzxCpu(uint8_t reg, uint32_t disp) {
+    emit8(0x0F); emit8(0xB6); emitModRM(reg, disp);
+}
+
+/**
+ * @brief mov byte [rbx + disp], reg
+ */
+void JIT::emitStoreCpu(uint8_t reg, uint32_t disp) {
+    emit8(0x88); emitModRM(reg, disp);
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "CPU.hpp"
+
+class Atari;
+
+class JIT {
+public:
+    struct Op {
+        uint16_t pc;
+        uint16_t operand;
+        uint8_t opcode;
+        uint8_t length;
+        uint8_t cycles;
+    };
+
+    static bool scan(const uint8_t* rom, uint16_t pc, std::vector<Op>& ops);
+
+    JIT();
+    ~JIT();
+
+    void connectAtari(Atari* atari);
+    void setEnabled(bool enabled);
+    uint32_t run(uint32_t budget);
+    void flush();
+
+    bool m_enabled = false;
+
+    // Instructions executed by translated blocks and by the interpreter while enabled
+    uint64_t m_translated = 0;
+    uint64_t m_interpreted = 0;
+
+    // Blocks translated since the JIT was enabled
+    uint64_t m_blocksTranslated = 0;
+
+private:
+    typedef uint32_t (*BlockCode)(CPU* cpu);
+
+    struct Block {
+        BlockCode code = nullptr;
+        uint16_t heat = 0;
+        bool untranslatable = false;
+        uint8_t instructions = 0;
+
+        // Worst case number of cycles before the last instruction of the block starts
+        uint16_t maxStartCycles = 0;
+    };
+
+    void translate(uint16_t pc, Block& block);
+    bool setWritable(bool writable);
+    bool emitNative(const Op& op, uint32_t& cycles);
+    void emitCall(const Op& op, uint32_t cycles);
+    void emitMovePC(uint16_t pc);
+    void emitZeroSign();
+
+    // x86-64 encoding helpers
+    void emit8(uint8_t byte);
+    void emit16(uint16_t value);
+    void emit32(uint32_t value);
+    void emit64(uint64_t value);
+    void emitModRM(uint8_t reg, uint32_t disp);
+    void emitMovzxCpu(uint8_t reg, uint32_t disp);
+    void emitStoreCpu(uint8_t reg, uint32_t disp);
+
+    template <uint8_t Opcode> static uint8_t thunk(CPU* cpu);
+    template <size_t... Opcodes> static constexpr std::array<uint8_t (*)(CPU*), 0x100>
+        thunks(std::index_sequence<Opcodes...>);
+
+    Atari* m_atari = nullptr;
+    CPU* m_cpu = nullptr;
+
+    // Buffer the translated blocks are written into, used as a bump allocator. It is only
+    // writable while a block is emitted and only executable otherwise.
+    uint8_t* m_code = nullptr;
+    size_t m_codeSize = 0;
+    size_t m_codeUsed = 0;
+    uint8_t* m_emit = nullptr;
+
+    // Address of the block being translated the emitted code has moved the PC to so far
+    uint16_t m_emitPC = 0x0000;
+
+    // Translated blocks indexed by the offset of their start address into the cartridge
+    // (whichever mirror it runs at)
+    std::array<Block, SIZE_CART> m_blocks;
+
+    // Offsets of the CPU registers used by translated code
+    uint32_t m_offA, m_offX, m_offY, m_offP, m_offS, m_offPC;
+    uint32_t m_offOpcode, m_offOperand, m_offAdditionalCycle, m_offElapsed;
+};
@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstdint>
+
+// Pixels of a line
+#define WIDTH 160
+
+/**
+ * One bit for each pixel of a line, pixel x being bit x % 64 of word x / 64. Objects on the line
+ * are represented by the pixels they cover, so that whatever concerns all of a line's pixels at
+ * once (such as collisions) takes a handful of word operations instead of a loop over the pixels.
+ */
+class LineMask {
+public:
+    constexpr LineMask() = default;
+    constexpr LineMask(uint64_t low, uint64_t middle, uint64_t high)
+        : m_words{ low, middle, high } {}
+
+    /**
+     * @brief Pixels from..to - 1.
+     */
+    static constexpr LineMask range(uint8_t from, uint8_t to) {
+        return ones(to) & ~ones(from);
+    }
+
+    /**
+     * @brief Pixels 0..count - 1.
+     */
+    static constexpr LineMask ones(uint8_t count) {
+        LineMask mask;
+
+        for (int i = 0; i < 3; i++) {
+            int bits = count - i * 64;
+            mask.m_words[i] = bits >= 64 ? ~0ull : bits > 0 ? (1ull << bits) - 1 : 0;
+        }
+
+        return mask;
+    }
+
+    /**
+     * @brief Move every pixel x to (x + count) % WIDTH, for objects wrapping around the end of the
+     * line.
+     */
+    constexpr LineMask rotate(uint8_t count) const {
+        return (shiftLeft(count) | shiftRight(WIDTH - count)) & ones(WIDTH);
+    }
+
+    constexpr LineMask shiftLeft(uint8_t count) const {
+        LineMask mask;
+        int words = count / 64, bits = count % 64;
+
+        for (int i = 2; i >= words; i--) {
+            mask.m_words[i] = m_words[i - words] << bits;
+            if (bits && i - words > 0) {
+                mask.m_words[i] |= m_words[i - words - 1] >> (64 - bits);
+            }
+        }
+
+        return mask;
+    }
+
+    constexpr LineMask shiftRight(uint8_t count) const {
+        LineMask mask;
+        int words = count / 64, bits = count % 64;
+
+        for (int i = 0; i + words < 3; i++) {
+            mask.m_words[i] = m_words[i + words] >> bits;
+            if (bits && i + words < 2) {
+                mask.m_words[i] |= m_words[i + words + 1] << (64 - bits);
+            }
+        }
+
+        return mask;
+    }
+
+    constexpr bool test(uint8_t x) const {
+        return (m_words[x / 64] >> (x % 64)) & 0x01;
+    }
+
+    /**
+     * @brief Call the given function with every pixel in the mask, from left to right.
+     */
+    template <typename Function>
+    void forEach(Function function) const {
+        for (int i = 0; i < 3; i++) {
+            for (uint64_t word = m_words[i]; word; word &= word - 1) {
+                function(i * 64 + __builtin_ctzll(word));
+            }
+        }
+    }
+
+    /**
+     * @brief Pixels 64 * i..64 * i + 63, pixel 64 * i being bit 0.
+     */
+    constexpr uint64_t word(int i) const {
+        return m_words[i];
+    }
+
+    constexpr bool any() const {
+        return m_words[0] | m_words[1] | m_words[2];
+    }
+
+    constexpr LineMask operator&(const LineMask& other) const {
+        return LineMask(m_words[0] & other.m_words[0], m_words[1] & other.m_words[1],
+            m_words[2] & other.m_words[2]);
+    }
+
+    constexpr LineMask operator|(const LineMask& other) const {
+        return LineMask(m_words[0] | other.m_words[0], m_words[1] | other.m_words[1],
+            m_words[2] | other.m_words[2]);
+    }
+
+    constexpr LineMask operator~() const {
+        return LineMask(~m_words[0], ~m_words[1], ~m_words[2]);
+    }
+
+private:
+    uint64_t m_words[3] = {};
+};
@@ -0,0 +1,82 @@
+/*
+ *                                 $$ $$$$$ $$
+ *                                 $$ $$$$$ $$
+ *                                .$$ $$$$$ $$.
+ *                                :$$ $$$$$ $$:
+ *                                $$$ $$$$$ $$$
+ *                                $$$ $$$$$ $$$
+ *                               ,$$$ $$$$$ $$$.
+ *                              ,$$$$ $$$$$ $$$$.
+ *                             ,$$$$; $$$$$ :$$$$.
+ *                            ,$$$$$  $$$$$  $$$$$.
+ *                          ,$$$$$$'  $$$$$  `$$$$$$.
+ *                        ,$$$$$$$'   $$$$$   `$$$$$$$.
+ *                     ,s$$$$$$$'     $$$$$     `$$$$$$$s.
+ *                   $$$$$$$$$'       $$$$$       `$$$$$$$$$
+ *                   $$$$$Y'          $$$$$          `Y$$$$$
+ *
+ * NullAudioDevice.cpp: an audio output which plays to nowhere, but at its sample rate in real
+ * time, for frontends without an audio library (or machines without a sound card).
+ *
+ * It keeps the two things a real device tells its client, how much sound it has played and how
+ * much is still queued for it, so that the frontends can be paced by the audio output (see
+ * Pacer::reportAudio()) and their audio latency measured the same as with a device. Its clock is
+ * the monotonic clock, so it never drifts from it the way a sound card's crystal does; the pacer's
+ * rate adjustment then only corrects for frames arriving in bursts.
+ */
+#include <algorithm>
+
+#include "NullAudioDevice.hpp"
+
+NullAudioDevice::NullAudioDevice() = default;
+NullAudioDevice::~NullAudioDevice() = default;
+
+/**
+ * @brief Start playing at the given sample rate, with nothing queued.
+ */
+void NullAudioDevice::open(uint32_t rate) {
+    m_rate = rate;
+    m_played = 0;
+    m_underrun = 0;
+    m_overrun = 0;
+    m_queued = 0;
+    m_start = Clock::now();
+}
+
+/**
+ * @brief Queue samples to be played after those already queued. Samples which don't fit in
+ * NULL_AUDIO_CAPACITY are dropped, and nothing is queued before the device is opened.
+ */
+void NullAudioDevice::write(const float*, size_t count) {
+    size_t capacity = static_cast<size_t>(NULL_AUDIO_CAPACITY * m_rate);
+    size_t queued = std::min(count, capacity - std::min(capacity, m_queued));
+
+    m_overrun += count - queued;
+    m_queued += queued;
+}
+
+/**
+ * @brief Play the samples whose time has come since the last update, or silence if there aren't
+ * enough queued.
+ */
+void NullAudioDevice::update() {
+    if (!m_rate) {
+        return;
+    }
+
+    double elapsed = std::chrono::duration<double>(Clock::now() - m_start).count();
+    uint64_t played = static_cast<uint64_t>(elapsed * m_rate);
+    uint64_t count = played - std::min(played, m_played);
+    size_t consumed = static_cast<size_t>(std::min<uint64_t>(count, m_queued));
+
+    m_underrun += count - consumed;
+    m_queued -= consumed;
+    m_played += count;
+}
+
+/**
+ * @brief Samples written but not played yet.
+ */
+size_t NullAudioDevice::queued() const {
+    return m_queued;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#include "AudioSink.hpp"
+
+// Sound the device can hold, in seconds; whatever is written beyond that is dropped
+#define NULL_AUDIO_CAPACITY 0.5
+
+class NullAudioDevice : public AudioSink {
+public:
+    NullAudioDevice();
+    ~NullAudioDevice();
+
+    void open(uint32_t rate);
+    void write(const float* samples, size_t count) override;
+    void update();
+    size_t queued() const;
+
+    // Sample rate, 0 until the device is opened
+    uint32_t m_rate = 0;
+
+    // Samples played since the device was opened, including the silence of underruns
+    uint64_t m_played = 0;
+
+    // Samples of silence played because nothing was queued, and samples dropped for lack of room
+    uint64_t m_underrun = 0;
+    uint64_t m_overrun = 0;
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    // When the device started playing
+    Clock::time_point m_start;
+
+    // Samples written but not played yet
+    size_t m_queued = 0;
+};
@@ -0,0 +1,119 @@
+/*
+ *                                 $$ $$$$$ $$
+ *                                 $$ $$$$$ $$
+ *                                .$$ $$$$$ $$.
+ *                                :$$ $$$$$ $$:
+ *                                $$$ $$$$$ $$$
+ *                                $$$ $$$$$ $$$
+ *                               ,$$$ $$$$$ $$$.
+ *                              ,$$$$ $$$$$ $$$$.
+ *                             ,$$$$; $$$$$ :$$$$.
+ *                            ,$$$$$  $$$$$  $$$$$.
+ *                          ,$$$$$$'  $$$$$  `$$$$$$.
+ *                        ,$$$$$$$'   $$$$$   `$$$$$$$.
+ *                     ,s$$$$$$$'     $$$$$     `$$$$$$$s.
+ *                   $$$$$$$$$'       $$$$$       `$$$$$$$$$
+ *                   $$$$$Y'          $$$$$          `Y$$$$$
+ *
+ * Pacer.cpp: decides when the frontend runs the next frame, so that the game runs at the speed of
+ * the real console whatever the rate the window is redrawn at.
+ *
+ * The emulation follows a master clock. With an audio output, that's the sound it has played:
+ * frames are run whenever the sound queued for it falls below PACER_LATENCY, and since the
+ * emulation and the audio device never quite agree on what a second is, the rate of the sound is
+ * nudged up or down by a fraction of a percent (see getRateAdjustment()) to keep the queue from
+ * creeping towards empty or full. When muted, the master clock is the monotonic clock, and frames
+ * are run as their time comes.
+ */
+#include <algorithm>
+
+#include "Pacer.hpp"
+
+Pacer::Pacer() {
+    reset(0.0);
+}
+
+Pacer::~Pacer() = default;
+
+/**
+ * @brief Start pacing from now, the emulation being at the given time (in seconds of emulated
+ * time), e.g. after a reset or after loading a state.
+ */
+void Pacer::reset(double emulated) {
+    m_start = Clock::now();
+    m_offset = emulated - (m_outputRate ? m_played / m_outputRate : 0.0);
+    m_adjustment = 1.0;
+}
+
+/**
+ * @brief Report the state of the audio output, making it the master clock: the samples it has
+ * played since it was opened and those queued for it but not played yet. To be called whenever
+ * it consumes some sound.
+ */
+void Pacer::reportAudio(double outputRate, uint64_t played, size_t queued) {
+    if (!m_outputRate) {
+        // Carry on from where the monotonic clock was
+        m_offset = masterTime() - played / outputRate;
+    }
+    m_outputRate = outputRate;
+    m_played = played;
+
+    m_metrics.audioLatency += PACER_SMOOTHING * (queued / outputRate - m_metrics.audioLatency);
+
+    double error = (m_metrics.audioLatency - PACER_LATENCY) / PACER_LATENCY;
+    m_adjustment = 1.0 + std::max(-1.0, std::min(1.0, error)) * PACER_MAX_ADJUST;
+}
+
+/**
+ * @brief Whether the emulation, at the given time (in seconds of emulated time), should run
+ * another frame now.
+ */
+bool Pacer::frameDue(double emulated) {
+    double lead = emulated - masterTime();
+
+    if (lead < -PACER_MAX_LAG) {
+        m_offset += lead;
+        m_metrics.resyncs++;
+        lead = 0.0;
+    }
+
+    return lead < (m_outputRate ? PACER_LATENCY : 0.0);
+}
+
+/**
+ * @brief Factor to multiply the resampler's ratio by (see Resampler::setRatio()): above 1 when
+ * the audio output has too much sound queued, to produce a little less of it, and below 1 when
+ * it's running short.
+ */
+double Pacer::getRateAdjustment() const {
+    return m_adjustment;
+}
+
+/**
+ * @brief Note that the inputs have just been polled and written to the machine.
+ */
+void Pacer::inputsPolled() {
+    m_polled = Clock::now();
+}
+
+/**
+ * @brief Note that a frame emulated since the inputs were last polled has just been presented,
+ * i.e. uploaded and swapped to the display, and account for the latency.
+ */
+void Pacer::framePresented() {
+    double latency = std::chrono::duration<double>(Clock::now() - m_polled).count();
+
+    m_metrics.inputToPresent += PACER_SMOOTHING * (latency - m_metrics.inputToPresent);
+    m_metrics.maxInputToPresent = std::max(m_metrics.maxInputToPresent, latency);
+}
+
+/**
+ * @brief The master clock in seconds of emulated time.
+ */
+double Pacer::masterTime() const {
+    if (m_outputRate) {
+        return m_played / m_outputRate + m_offset;
+    }
+
+    return std::chrono::duration<double>(Clock::now() - m_start).count() + m_offset;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+// How far ahead of the master clock the emulation runs with an audio output: the amount of sound
+// kept queued for it, in seconds
+#define PACER_LATENCY 0.050
+
+// Emulation further behind the master clock than this (in seconds) skips ahead instead of
+// catching up, e.g. after the window was dragged
+#define PACER_MAX_LAG 0.250
+
+// Largest change of the sound's rate to keep the audio output's queue at PACER_LATENCY: small
+// enough not to be heard as a change of pitch
+#define PACER_MAX_ADJUST 0.005
+
+// Weight of the latest measurement in the smoothed metrics
+#define PACER_SMOOTHING 0.05
+
+class Pacer {
+public:
+    /**
+     * Latencies measured while pacing, in seconds, smoothed over the last few dozen frames.
+     */
+    struct Metrics {
+        // From polling the inputs to the display showing the first frame emulated with them
+        double inputToPresent = 0.0;
+        double maxInputToPresent = 0.0;
+
+        // Sound queued for the audio output, i.e. from emulating it to hearing it; 0 when muted
+        double audioLatency = 0.0;
+
+        // Times the emulation fell more than PACER_MAX_LAG behind and skipped ahead
+        uint64_t resyncs = 0;
+    };
+
+    Pacer();
+    ~Pacer();
+
+    void reset(double emulated);
+    void reportAudio(double outputRate, uint64_t played, size_t queued);
+    bool frameDue(double emulated);
+    double getRateAdjustment() const;
+    void inputsPolled();
+    void framePresented();
+
+    Metrics m_metrics;
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    double masterTime() const;
+
+    // Master clock: the sound the audio output has played if there is one (m_outputRate isn't 0),
+    // the monotonic clock since m_start when muted; offset so that it starts at the emulated time
+    Clock::time_point m_start;
+    double m_offset = 0.0;
+    double m_outputRate = 0.0;
+    uint64_t m_played = 0;
+
+    // Factor the rate of the sound is adjusted by (see getRateAdjustment())
+    double m_adjustment = 1.0;
+
+    // When the inputs were last polled
+    Clock::time_point m_polled;
+};
@@ -0,0 +1,122 @@
+/**
+ *                                 $$ $$$$$ $$
+ *                                 $$ $$$$$ $$
+ *                                .$$ $$$$$ $$.
+ *                                :$$ $$$$$ $$:
+ *                                $$$ $$$$$ $$$
+ *                                $$$ $$$$$ $$$
+ *                               ,$$$ $$$$$ $$$.
+ *                              ,$$$$ $$$$$ $$$$.
+ *                             ,$$$$; $$$$$ :$$$$.
+ *                            ,$$$$$  $$$$$  $$$$$.
+ *                          ,$$$$$$'  $$$$$  `$$$$$$.
+ *                        ,$$$$$$$'   $$$$$   `$$$$$$$.
+ *                     ,s$$$$$$$'     $$$$$     `$$$$$$$s.
+ *                   $$$$$$$$$'       $$$$$       `$$$$$$$$$
+ *                   $$$$$Y'          $$$$$          `Y$$$$$
+ *
+ * Plugin.cpp: loader for ROMs which have been recompiled ahead of time into a shared object (see
+ * Recompiler.cpp). Plugins are looked up by the hash of the cartridge ROM; recompiled blocks then
+ * run in place of the interpreter under the same rules as the JIT's translated blocks.
+ */
+#include <cinttypes>
+#include <cstdio>
+#include <iostream>
+
+#include <dlfcn.h>
+
+#include "Atari.hpp"
+#include "Plugin.hpp"
+#include "Recompiled.hpp"
+
+Plugin::Plugin() = default;
+
+Plugin::~Plugin() {
+    unload();
+}
+
+void Plugin::connectAtari(Atari* atari) {
+    m_atari = atari;
+}
+
+/**
+ * @brief 64-bit FNV-1a hash of the SIZE_CART bytes of a cartridge ROM, naming its plugin.
+ */
+uint64_t Plugin::romHash(const uint8_t* rom) {
+    uint64_t hash = 0xCBF29CE484222325;
+
+    for (int i = 0; i < SIZE_CART; i++) {
+        hash = (hash ^ rom[i]) * 0x100000001B3;
+    }
+
+    return hash;
+}
+
+/**
+ * Load the plugin recompiled from the cartridge currently in memory, i.e. the shared object
+ * named after the ROM's hash (as printed by the recompiler) in the given directory.
+ * @return true if a matching plugin was loaded
+ */
+bool Plugin::load(const std::string& directory) {
+    unload();
+
+    uint64_t hash = romHash(m_atari->m_rom.data());
+    char name[32];
+    snprintf(name, sizeof(name), "/%016" PRIx64 ".so", hash);
+
+    m_handle = dlopen((directory + name).c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (!m_handle) {
+        return false;
+    }
+
+    RecompiledEntry entry = reinterpret_cast<RecompiledEntry>(dlsym(m_handle, RECOMPILED_ENTRY));
+    const RecompiledModule* module = entry ? entry() : nullptr;
+
+    if (!module || module->version != RECOMPILED_VERSION || module->romHash != hash) {
+        std::cout << "Ignoring incompatible plugin " << directory + name << std::endl;
+        unload();
+        return false;
+    }
+
+    m_blocks.fill(nullptr);
+    for (size_t i = 0; i < module->count; i++) {
+        m_blocks[module->blocks[i].offset & (SIZE_CART - 1)] = &module->blocks[i];
+    }
+
+    m_loaded = true;
+    return true;
+}
+
+void Plugin::unload() {
+    m_loaded = false;
+    if (m_handle) {
+        dlclose(m_handle);
+        m_handle = nullptr;
+    }
+}
+
+/**
+ * Run the recompiled block starting at the CPU's PC. Addresses which are not a known entry point
+ * of the ROM, and blocks which may not finish within the budget (see JIT::run()), are left to
+ * the interpreter.
+ * @return Number of CPU cycles consumed, or 0 if the interpreter has to execute the next
+ * instruction instead
+ */
+uint32_t Plugin::run(uint32_t budget) {
+    if (!m_loaded || m_atari->m_cpu.m_cycles) {
+        return 0;
+    }
+
+    uint16_t pc = m_atari->m_cpu.m_pc;
+    if (Atari::isCart(pc)) {
+        const RecompiledBlock* block = m_blocks[pc & (SIZE_CART - 1)];
+
+        if (block && block->maxStartCycles <= budget) {
+            m_recompiled += block->instructions;
+            return block->run(m_atari->m_cpu, *m_atari);
+        }
+    }
+
+    m_interpreted++;
+    return 0;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+#include "CPU.hpp"
+
+class Atari;
+struct RecompiledBlock;
+
+class Plugin {
+public:
+    Plugin();
+    ~Plugin();
+
+    void connectAtari(Atari* atari);
+    bool load(const std::string& directory);
+    void unload();
+    uint32_t run(uint32_t budget);
+
+    static uint64_t romHash(const uint8_t* rom);
+
+    bool m_loaded = false;
+
+    // Instructions executed by recompiled blocks and by the interpreter while loaded
+    uint64_t m_recompiled = 0;
+    uint64_t m_interpreted = 0;
+
+private:
+    Atari* m_atari = nullptr;
+    void* m_handle = nullptr;
+
+    // Recompiled blocks indexed by the offset of their start address into the cartridge
+    // (whichever mirror it runs at)
+    std::array<const RecompiledBlock*, SIZE_CART> m_blocks;
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Atari.hpp"
+
+// Bumped whenever the interface between the emulator and recompiled ROM plugins changes
+#define RECOMPILED_VERSION 4
+
+// Function every plugin exports, returning its RecompiledModule
+#define RECOMPILED_ENTRY "atari2600Recompiled"
+
+typedef uint32_t (*RecompiledRun)(CPU& cpu, Atari& atari);
+
+struct RecompiledBlock {
+    // Offset of the block's start into the cartridge; it runs at whichever mirror it is entered
+    uint16_t offset;
+    RecompiledRun run;
+
+    // Worst case number of cycles before the last instruction of the block starts
+    uint16_t maxStartCycles;
+    uint8_t instructions;
+};
+
+struct RecompiledModule {
+    uint32_t version;
+    uint64_t romHash;
+    const RecompiledBlock* blocks;
+    size_t count;
+};
+
+typedef const RecompiledModule* (*RecompiledEntry)();
+
+/**
+ * Interface between a ROM which has been statically recompiled into C++ (see Recompiler.cpp) and
+ * the emulator. The generated code works on the CPU's registers through this class and on memory
+ * through the same Atari bus the CPU uses; instructions it doesn't implement itself are handed to
+ * the interpreter's handlers. Addresses of the block's instructions are given relative to the
+ * block's start, so the same code runs at every mirror of the cartridge.
+ */
+class Recompiled {
+public:
+    Recompiled(CPU& cpu, Atari& atari) : m_cpu{cpu}, m_atari{atari}, m_start{cpu.m_pc} {}
+    ~Recompiled() { m_cpu.m_elapsed = 0; }
+
+    uint8_t& a() { return m_cpu.m_a; }
+    uint8_t& x() { return m_cpu.m_x; }
+    uint8_t& y() { return m_cpu.m_y; }
+    uint8_t& s() { return m_cpu.m_s; }
+    uint8_t& p() { return m_cpu.m_p; }
+    void setPC(uint16_t offset) { m_cpu.m_pc = m_start + offset; }
+
+    uint8_t read(uint16_t addr) { return m_atari.read8(addr); }
+    void write(uint16_t addr, uint8_t data) { m_atari.write8(addr, data); }
+
+    /**
+     * @brief Same as CPU::setZEROSIGN().
+     */
+    void zn(uint8_t value) {
+        m_cpu.m_p = (m_cpu.m_p & ~(CPU::ZERO | CPU::SIGN)) | (value ? 0 : CPU::ZERO)
+            | (value & CPU::SIGN);
+    }
+
+    /**
+     * @brief Run an instruction through the interpreter and count the cycles it took. The cycles
+     * of the block's written out instructions before it are passed in, so that the handler
+     * accesses the TIA/RIOT registers on the right cycle (see CPU::m_elapsed). Next is the
+     * offset of the following instruction from the block's start.
+     */
+    void exec(uint8_t opcode, uint16_t operand, uint16_t next, uint32_t before) {
+        m_cpu.m_elapsed = m_cycles + before;
+        m_cycles += m_cpu.execute(opcode, operand, m_start + next);
+    }
+
+    // Cycles of the instructions executed with exec()
+    uint32_t m_cycles = 0;
+
+private:
+    CPU& m_cpu;
+    Atari& m_atari;
+
+    // PC the block was entered at
+    uint16_t m_start;
+};
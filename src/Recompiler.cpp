@@ -0,0 +1,274 @@
+/**
+ *                                 $$ $$$$$ $$
+ *                                 $$ $$$$$ $$
+ *                                .$$ $$$$$ $$.
+ *                                :$$ $$$$$ $$:
+ *                                $$$ $$$$$ $$$
+ *                                $$$ $$$$$ $$$
+ *                               ,$$$ $$$$$ $$$.
+ *                              ,$$$$ $$$$$ $$$$.
+ *                             ,$$$$; $$$$$ :$$$$.
+ *                            ,$$$$$  $$$$$  $$$$$.
+ *                          ,$$$$$$'  $$$$$  `$$$$$$.
+ *                        ,$$$$$$$'   $$$$$   `$$$$$$$.
+ *                     ,s$$$$$$$'     $$$$$     `$$$$$$$s.
+ *                   $$$$$$$$$'       $$$$$       `$$$$$$$$$
+ *                   $$$$$Y'          $$$$$          `Y$$$$$
+ *
+ * Recompiler.cpp: tool which statically recompiles a cartridge ROM into C++ source, to be built
+ * into a plugin the emulator loads in place of the interpreter for that ROM (see Plugin.cpp).
+ *
+ * Usage: recompiler ROM DIRECTORY
+ *
+ * Code is discovered by following the control flow from the reset and interrupt vectors. Every
+ * reachable address becomes an entry point of a block, formed by the same rules as the JIT's
+ * translated blocks (see JIT::scan()), so the emulator stays cycle exact. Indirect jumps, returns
+ * and any address not discovered here are left to the interpreter at run time.
+ */
+#include <cinttypes>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <set>
+#include <sstream>
+#include <vector>
+
+#include "Atari.hpp"
+#include "Plugin.hpp"
+#include "Recompiled.hpp"
+
+/**
+ * @brief Disassemble the given instruction in the usual 6502 assembler syntax.
+ */
+static std::string disassemble(const JIT::Op& op) {
+    const CPU::Mnemonic& mnemonic = CPU::s_mnemonics[op.opcode];
+    uint16_t next = op.pc + op.length;
+    char operand[16] = "";
+
+    switch (op.length == 1 ? CPU::AddrMode::IMP : mnemonic.mode) {
+        case CPU::AddrMode::ABS: snprintf(operand, sizeof(operand), " $%04X", op.operand); break;
+        case CPU::AddrMode::ABX: snprintf(operand, sizeof(operand), " $%04X,X", op.operand); break;
+        case CPU::AddrMode::ABY: snprintf(operand, sizeof(operand), " $%04X,Y", op.operand); break;
+        case CPU::AddrMode::IDX: snprintf(operand, sizeof(operand), " ($%02X,X)", op.operand); break;
+        case CPU::AddrMode::IDY: snprintf(operand, sizeof(operand), " ($%02X),Y", op.operand); break;
+        case CPU::AddrMode::IMM: snprintf(operand, sizeof(operand), " #$%02X", op.operand); break;
+        case CPU::AddrMode::IND: snprintf(operand, sizeof(operand), " ($%04X)", op.operand); break;
+        case CPU::AddrMode::ZPX: snprintf(operand, sizeof(operand), " $%02X,X", op.operand); break;
+        case CPU::AddrMode::ZPY: snprintf(operand, sizeof(operand), " $%02X,Y", op.operand); break;
+        case CPU::AddrMode::ZRP: snprintf(operand, sizeof(operand), " $%02X", op.operand); break;
+        case CPU::AddrMode::REL:
+            snprintf(operand, sizeof(operand), " $%04X", (uint16_t) (next + (int8_t) op.operand));
+            break;
+        default:
+            if (mnemonic.mode == CPU::AddrMode::ACC) {
+                snprintf(operand, sizeof(operand), " A");
+            }
+            break;
+    }
+
+    return std::string(mnemonic.name) + operand;
+}
+
+/**
+ * Emit the C++ statement for one instruction. Simple instructions (the same ones the JIT emits
+ * natively) are written out; everything else is executed by the interpreter's handler, passed the
+ * PC following the instruction relative to the block's start.
+ * @return true if the instruction was written out, false if it calls the interpreter
+ */
+static bool emit(std::ostream& out, const JIT::Op& op, uint16_t start, uint32_t cycles) {
+    static const char* const regs[] = { "r.y()", "r.a()", "r.x()" };
+    char line[96];
+
+    switch (op.opcode) {
+        case 0xAA: out << "    r.zn(r.x() = r.a());\n"; return true;
+        case 0xA8: out << "    r.zn(r.y() = r.a());\n"; return true;
+        case 0x8A: out << "    r.zn(r.a() = r.x());\n"; return true;
+        case 0x98: out << "    r.zn(r.a() = r.y());\n"; return true;
+        case 0xBA: out << "    r.zn(r.x() = r.s());\n"; return true;
+        case 0x9A: out << "    r.s() = r.x();\n"; return true;
+        case 0xE8: out << "    r.zn(++r.x());\n"; return true;
+        case 0xC8: out << "    r.zn(++r.y());\n"; return true;
+        case 0xCA: out << "    r.zn(--r.x());\n"; return true;
+        case 0x88: out << "    r.zn(--r.y());\n"; return true;
+        case 0x18: out << "    r.p() &= ~CPU::CARRY;\n"; return true;
+        case 0x38: out << "    r.p() |= CPU::CARRY;\n"; return true;
+        case 0xD8: out << "    r.p() &= ~CPU::DECIMAL;\n"; return true;
+        case 0xF8: out << "    r.p() |= CPU::DECIMAL;\n"; return true;
+        case 0x58: out << "    r.p() &= ~CPU::INTERRUPT;\n"; return true;
+        case 0x78: out << "    r.p() |= CPU::INTERRUPT;\n"; return true;
+        case 0xB8: out << "    r.p() &= ~CPU::OVERFLOW;\n"; return true;
+        case 0xEA: return true;
+        case 0xA9: case 0xA2: case 0xA0:
+            snprintf(line, sizeof(line), "    r.zn(%s = 0x%02X);\n", regs[op.opcode & 0x03],
+                op.operand);
+            out << line;
+            return true;
+        case 0xA5: case 0xA6: case 0xA4: case 0xAD: case 0xAE: case 0xAC:
+            if (!Atari::isRam(op.operand)) {
+                break;
+            }
+            snprintf(line, sizeof(line), "    r.zn(%s = r.read(0x%04X));\n",
+                regs[op.opcode & 0x03], op.operand);
+            out << line;
+            return true;
+        case 0x85: case 0x86: case 0x84: case 0x8D: case 0x8E: case 0x8C:
+            snprintf(line, sizeof(line), "    r.write(0x%04X, %s);\n", op.operand,
+                regs[op.opcode & 0x03]);
+            out << line;
+            return true;
+        default:
+            break;
+    }
+
+    snprintf(line, sizeof(line), "    r.exec(0x%02X, 0x%04X, 0x%04X, %u);\n", op.opcode,
+        op.operand, (uint16_t) (op.pc + op.length - start), cycles);
+    out << line;
+    return false;
+}
+
+/**
+ * @brief Read the interrupt vector at the given address from the end of the cartridge ROM.
+ */
+static uint16_t vector(const std::vector<uint8_t>& rom, uint16_t addr) {
+    return rom[addr & (SIZE_CART - 1)] | (rom[(addr + 1) & (SIZE_CART - 1)] << 8);
+}
+
+/**
+ * @brief Addresses execution may continue at after the given block.
+ */
+static std::vector<uint16_t> successors(const std::vector<uint8_t>& rom,
+        const std::vector<JIT::Op>& ops) {
+    const JIT::Op& last = ops.back();
+    uint16_t next = last.pc + last.length;
+
+    switch (CPU::s_mnemonics[last.opcode].flow) {
+        case CPU::Flow::BRANCH: return { next, (uint16_t) (next + (int8_t) last.operand) };
+        case CPU::Flow::JUMP: return { last.operand };
+        // Assume the subroutine returns right after the call
+        case CPU::Flow::CALL: return { last.operand, next };
+        case CPU::Flow::BREAK: return { vector(rom, IRQ_VECTOR) };
+        case CPU::Flow::SKIP_BYTE: return { (uint16_t) (last.pc + 2) };
+        case CPU::Flow::SKIP_WORD: return { (uint16_t) (last.pc + 3) };
+        case CPU::Flow::RETURN: case CPU::Flow::HALT: return {};
+        case CPU::Flow::NEXT: break;
+    }
+
+    return { next };
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 3) {
+        std::cout << "Usage: " << argv[0] << " ROM DIRECTORY" << std::endl;
+        return 1;
+    }
+
+    std::vector<uint8_t> rom(SIZE_CART);
+    std::ifstream ifs(argv[1], std::ifstream::binary);
+
+    if (!ifs.read((char*) rom.data(), SIZE_CART)) {
+        std::cout << "Error reading file" << std::endl;
+        return 1;
+    }
+
+    uint64_t hash = Plugin::romHash(rom.data());
+    std::set<uint16_t> visited;
+    std::vector<uint16_t> pending = { vector(rom, RESET_VECTOR), vector(rom, IRQ_VECTOR) };
+    std::map<uint16_t, std::string> blocks, table;
+
+    while (!pending.empty()) {
+        uint16_t pc = pending.back();
+        pending.pop_back();
+
+        // A block is the same at every mirror of the cartridge, and so is its plugin entry
+        uint16_t offset = pc & (SIZE_CART - 1);
+        if (!Atari::isCart(pc) || !visited.insert(offset).second) {
+            continue;
+        }
+
+        std::vector<JIT::Op> ops;
+        if (!JIT::scan(rom.data(), pc, ops)) {
+            // Left to the interpreter; carry on with whatever follows it
+            uint8_t opcode = rom[offset];
+            const CPU::Mnemonic& mnemonic = CPU::s_mnemonics[opcode];
+
+            if (mnemonic.flow != CPU::Flow::HALT && mnemonic.mode != CPU::AddrMode::IND) {
+                pending.push_back(pc + CPU::instructionLength(opcode));
+            }
+            continue;
+        }
+
+        std::ostringstream code;
+        char header[64];
+        uint32_t cycles = 0;
+        uint16_t maxStartCycles = 0;
+        bool written = false;
+
+        snprintf(header, sizeof(header), "uint32_t block%03X(CPU& cpu, Atari& atari) {\n", offset);
+        code << header << "    Recompiled r{cpu, atari};\n\n";
+        for (size_t i = 0; i < ops.size(); i++) {
+            uint8_t maxCycles = ops[i].cycles;
+
+            snprintf(header, sizeof(header), "    // %04X: ", ops[i].pc);
+            code << header << disassemble(ops[i]) << "\n";
+            written = emit(code, ops[i], pc, cycles);
+            if (written) {
+                cycles += ops[i].cycles;
+            } else {
+                maxCycles += CPU::s_mnemonics[ops[i].opcode].mode == CPU::AddrMode::REL ? 2 : 1;
+            }
+
+            if (i + 1 < ops.size()) {
+                maxStartCycles += maxCycles;
+            }
+        }
+
+        if (written) {
+            snprintf(header, sizeof(header), "    r.setPC(0x%04X);\n",
+                (uint16_t) (ops.back().pc + ops.back().length - pc));
+            code << header;
+        }
+        code << "    return r.m_cycles + " << cycles << ";\n}\n\n";
+        blocks[offset] = code.str();
+
+        snprintf(header, sizeof(header), "    { 0x%03X, block%03X, %u, %zu },\n", offset, offset,
+            maxStartCycles, ops.size());
+        table[offset] = header;
+
+        for (uint16_t successor : successors(rom, ops)) {
+            pending.push_back(successor);
+        }
+    }
+
+    char path[64];
+    snprintf(path, sizeof(path), "/%016" PRIx64 ".cpp", hash);
+    std::ofstream out(argv[2] + std::string(path));
+
+    out << "// Recompiled from " << argv[1] << " by the recompiler; do not edit.\n"
+        << "#include \"Recompiled.hpp\"\n\n"
+        << "namespace {\n\n";
+    for (const auto& block : blocks) {
+        out << block.second;
+    }
+
+    out << "const RecompiledBlock blocks[] = {\n";
+    for (const auto& entry : table) {
+        out << entry.second;
+    }
+
+    out << "};\n\n"
+        << "}\n\n"
+        << "extern \"C\" const RecompiledModule* " RECOMPILED_ENTRY "() {\n"
+        << "    static const RecompiledModule module = {\n"
+        << "        RECOMPILED_VERSION, 0x" << std::hex << hash << std::dec << "ULL, blocks, "
+        << blocks.size() << "\n    };\n\n"
+        << "    return &module;\n}\n";
+
+    if (!out) {
+        std::cout << "Error writing " << argv[2] << path << std::endl;
+        return 1;
+    }
+
+    std::cout << argv[2] << path << ": " << blocks.size() << " blocks" << std::endl;
+    return 0;
+}
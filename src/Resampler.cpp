@@ -0,0 +1,262 @@
+/*
+ *                                 $$ $$$$$ $$
+ *                                 $$ $$$$$ $$
+ *                                .$$ $$$$$ $$.
+ *                                :$$ $$$$$ $$:
+ *                                $$$ $$$$$ $$$
+ *                                $$$ $$$$$ $$$
+ *                               ,$$$ $$$$$ $$$.
+ *                              ,$$$$ $$$$$ $$$$.
+ *                             ,$$$$; $$$$$ :$$$$.
+ *                            ,$$$$$  $$$$$  $$$$$.
+ *                          ,$$$$$$'  $$$$$  `$$$$$$.
+ *                        ,$$$$$$$'   $$$$$   `$$$$$$$.
+ *                     ,s$$$$$$$'     $$$$$     `$$$$$$$s.
+ *                   $$$$$$$$$'       $$$$$       `$$$$$$$$$
+ *                   $$$$$Y'          $$$$$          `Y$$$$$
+ *
+ * Resampler.cpp: converts the TIA's sound (about 31.4 kHz, see Audio) to the rate of the audio
+ * output, typically 44.1 or 48 kHz.
+ *
+ * Every output sample is the inner product of a window of input samples with a band-limited
+ * interpolation filter (a Kaiser-windowed sinc) shifted by the fractional position of the output
+ * sample between two inputs. The filter is precomputed for RESAMPLER_PHASES positions between two
+ * input samples (a polyphase filter bank), and interpolated between the two phases nearest to the
+ * actual position. Since any position can be looked up this way, the ratio between the rates
+ * doesn't have to be rational and may change at any time, e.g. to keep the audio output's buffer
+ * from running dry or overflowing when the emulation doesn't quite run at the rate it's meant to.
+ *
+ * Applying the filter is where the time goes, so it comes in SSE and AVX2 versions, picked from
+ * what the CPU supports.
+ */
+#include <algorithm>
+#include <cmath>
+
+#include "Resampler.hpp"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define RESAMPLER_SIMD
+#include <immintrin.h>
+#endif
+
+/**
+ * Filter parameters of a quality level: the number of taps, the Kaiser window's beta (higher
+ * means more attenuation in the stopband but a wider transition band) and the cutoff as a fraction
+ * of the lower of the two Nyquist frequencies.
+ */
+struct FilterDesign {
+    uint32_t taps;
+    double beta;
+    double rolloff;
+};
+
+static const FilterDesign s_designs[] = {
+    { 8, 4.5, 0.80 },
+    { 16, 7.0, 0.88 },
+    { 32, 9.5, 0.92 }
+};
+
+/**
+ * @brief Zeroth order modified Bessel function of the first kind, for the Kaiser window.
+ */
+static double besselI0(double x) {
+    double sum = 1.0;
+    double term = 1.0;
+
+    for (int k = 1; term > sum * 1e-12; k++) {
+        term *= (x / (2 * k)) * (x / (2 * k));
+        sum += term;
+    }
+
+    return sum;
+}
+
+/**
+ * Apply the filter to a window of input samples: the inner product of the window with the taps of
+ * the given phase, interpolated towards those of the next phase (the next row of the bank) by the
+ * given weight.
+ */
+static float filterScalar(const float* window, const float* phase, uint32_t taps, float weight) {
+    const float* next = phase + taps;
+    float sum = 0.0f;
+
+    for (uint32_t i = 0; i < taps; i++) {
+        sum += window[i] * (phase[i] + weight * (next[i] - phase[i]));
+    }
+
+    return sum;
+}
+
+#ifdef RESAMPLER_SIMD
+/**
+ * @brief SSE version of filterScalar(), four taps at a time.
+ */
+static float filterSse(const float* window, const float* phase, uint32_t taps, float weight) {
+    const float* next = phase + taps;
+    const __m128 w = _mm_set1_ps(weight);
+    __m128 sum = _mm_setzero_ps();
+
+    for (uint32_t i = 0; i < taps; i += 4) {
+        __m128 current = _mm_loadu_ps(phase + i);
+        __m128 tap = _mm_add_ps(current,
+            _mm_mul_ps(w, _mm_sub_ps(_mm_loadu_ps(next + i), current)));
+        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_loadu_ps(window + i), tap));
+    }
+
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 0x55));
+    return _mm_cvtss_f32(sum);
+}
+
+/**
+ * @brief AVX2 version of filterScalar(), eight taps at a time with fused multiply-adds.
+ */
+__attribute__((target("avx2,fma")))
+static float filterAvx2(const float* window, const float* phase, uint32_t taps, float weight) {
+    const float* next = phase + taps;
+    const __m256 w = _mm256_set1_ps(weight);
+    __m256 sum = _mm256_setzero_ps();
+
+    for (uint32_t i = 0; i < taps; i += 8) {
+        __m256 current = _mm256_loadu_ps(phase + i);
+        __m256 tap = _mm256_fmadd_ps(w, _mm256_sub_ps(_mm256_loadu_ps(next + i), current),
+            current);
+        sum = _mm256_fmadd_ps(_mm256_loadu_ps(window + i), tap, sum);
+    }
+
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 0x55));
+    return _mm_cvtss_f32(half);
+}
+#endif
+
+Resampler::Resampler() {
+    setKernel(bestKernel());
+}
+
+Resampler::~Resampler() = default;
+
+/**
+ * Set up the conversion between the given sample rates: compute the filter bank for the quality
+ * level, with its cutoff below the Nyquist frequency of the lower rate, and start over from
+ * silence.
+ */
+void Resampler::configure(double inputRate, double outputRate, Quality quality) {
+    const FilterDesign& design = s_designs[static_cast<uint8_t>(quality)];
+    double cutoff = 0.5 * std::min(1.0, outputRate / inputRate) * design.rolloff;
+    double half = design.taps / 2;
+
+    m_taps = design.taps;
+    m_ratio = inputRate / outputRate;
+    m_bank.resize((RESAMPLER_PHASES + 1) * m_taps);
+
+    for (uint32_t phase = 0; phase <= RESAMPLER_PHASES; phase++) {
+        float* row = m_bank.data() + phase * m_taps;
+        double sum = 0.0;
+
+        // Tap k weighs the input sample k - (half - 1) - phase / RESAMPLER_PHASES samples away
+        // from the output sample, which therefore lags half - 1 input samples behind the window
+        for (uint32_t k = 0; k < m_taps; k++) {
+            double x = k - (half - 1) - static_cast<double>(phase) / RESAMPLER_PHASES;
+            double t = 2 * cutoff * x;
+            double sinc = t == 0.0 ? 1.0 : std::sin(M_PI * t) / (M_PI * t);
+            double window = besselI0(design.beta * std::sqrt(std::max(0.0, 1 - (x / half)
+                * (x / half)))) / besselI0(design.beta);
+
+            row[k] = static_cast<float>(2 * cutoff * sinc * window);
+            sum += row[k];
+        }
+
+        // Every phase passes DC unchanged
+        for (uint32_t k = 0; k < m_taps; k++) {
+            row[k] = static_cast<float>(row[k] / sum);
+        }
+    }
+
+    reset();
+}
+
+/**
+ * @brief Set the number of input samples consumed per output sample, inputRate / outputRate as
+ * configured, give or take the drift of either clock. Takes effect from the next output sample on;
+ * the filter isn't recomputed, so the ratio shouldn't stray far from the configured one.
+ */
+void Resampler::setRatio(double ratio) {
+    m_ratio = ratio;
+}
+
+double Resampler::getRatio() const {
+    return m_ratio;
+}
+
+/**
+ * @brief Use the given implementation of the filter, falling back to the scalar one if
+ * it isn't available on this build.
+ */
+void Resampler::setKernel(Kernel kernel) {
+    m_filter = filterScalar;
+#ifdef RESAMPLER_SIMD
+    if (kernel == Kernel::SSE) {
+        m_filter = filterSse;
+    } else if (kernel == Kernel::AVX2) {
+        m_filter = filterAvx2;
+    }
+#else
+    (void) kernel;
+#endif
+}
+
+/**
+ * @brief The fastest implementation of the filter the CPU runs.
+ */
+Resampler::Kernel Resampler::bestKernel() {
+#ifdef RESAMPLER_SIMD
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return Kernel::AVX2;
+    }
+    return Kernel::SSE;
+#else
+    return Kernel::SCALAR;
+#endif
+}
+
+/**
+ * @brief Drop the input buffered so far and start over as if everything before had been silence.
+ */
+void Resampler::reset() {
+    m_input.assign(m_taps / 2 - 1, 0.0f);
+    m_position = 0.0;
+}
+
+/**
+ * Append the given input samples and produce as many output samples as there is input for, up
+ * to the given capacity. Input left over is kept for the next call.
+ * @return Number of samples written to the output
+ */
+size_t Resampler::process(const float* input, size_t count, float* output, size_t capacity) {
+    size_t produced = 0;
+
+    m_input.insert(m_input.end(), input, input + count);
+
+    while (produced < capacity) {
+        size_t index = static_cast<size_t>(m_position);
+        if (index + m_taps > m_input.size()) {
+            break;
+        }
+
+        double phase = (m_position - index) * RESAMPLER_PHASES;
+        size_t row = static_cast<size_t>(phase);
+        float weight = static_cast<float>(phase - row);
+
+        output[produced++] = m_filter(m_input.data() + index, m_bank.data() + row * m_taps,
+            m_taps, weight);
+        m_position += m_ratio;
+    }
+
+    // Drop the input no output sample needs anymore
+    size_t consumed = std::min(static_cast<size_t>(m_position), m_input.size());
+    m_input.erase(m_input.begin(), m_input.begin() + consumed);
+    m_position -= consumed;
+    return produced;
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Phases the filter bank is computed for between two input samples; positions in between
+// interpolate between the two nearest phases
+#define RESAMPLER_PHASES 256
+
+class Resampler {
+public:
+    // Length of the filter, trading stopband attenuation and transition width for speed
+    enum class Quality : uint8_t {
+        LOW,
+        MEDIUM,
+        HIGH
+    };
+
+    // Implementation of the filter
+    enum class Kernel : uint8_t {
+        SCALAR,
+        SSE,
+        AVX2
+    };
+
+    Resampler();
+    ~Resampler();
+
+    void configure(double inputRate, double outputRate, Quality quality);
+    void setRatio(double ratio);
+    double getRatio() const;
+    void setKernel(Kernel kernel);
+    static Kernel bestKernel();
+    void reset();
+    size_t process(const float* input, size_t count, float* output, size_t capacity);
+
+    // Taps of the filter, a multiple of 8
+    uint32_t m_taps = 0;
+
+private:
+    typedef float (*Filter)(const float* window, const float* phase, uint32_t taps, float weight);
+
+    // Input samples consumed per output sample
+    double m_ratio = 1.0;
+
+    // Position of the next output sample in m_input, in input samples from the start of the window
+    // the filter is applied to
+    double m_position = 0.0;
+
+    // Input not consumed yet, starting with the history the filter still needs
+    std::vector<float> m_input;
+
+    // RESAMPLER_PHASES + 1 rows of m_taps coefficients, the last row being the first one shifted
+    // by a whole sample so that every phase has a next one to interpolate with
+    std::vector<float> m_bank;
+
+    Filter m_filter;
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+/**
+ * Lock-free queue between exactly one producer thread and one consumer thread, such as the
+ * emulation producing audio samples and the audio output consuming them. Neither side ever waits
+ * for the other: the producer drops what doesn't fit and the consumer takes whatever is there.
+ * The indices only ever grow (wrapping around size_t), so that the capacity, a power of two, can
+ * be used in full.
+ */
+template <typename T, size_t Capacity>
+class RingBuffer {
+    static_assert((Capacity & (Capacity - 1)) == 0, "the capacity has to be a power of two");
+
+public:
+    /**
+     * @brief Append up to count items (producer only).
+     * @return Number of items appended, fewer than count if the buffer filled up
+     */
+    size_t push(const T* items, size_t count) {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        size_t head = m_head.load(std::memory_order_acquire);
+
+        count = std::min(count, Capacity - (tail - head));
+        for (size_t i = 0; i < count; i++) {
+            m_items[(tail + i) & (Capacity - 1)] = items[i];
+        }
+
+        m_tail.store(tail + count, std::memory_order_release);
+        return count;
+    }
+
+    /**
+     * @brief Take up to count items out, oldest first (consumer only).
+     * @return Number of items taken, fewer than count if the buffer ran empty
+     */
+    size_t pop(T* items, size_t count) {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        size_t tail = m_tail.load(std::memory_order_acquire);
+
+        count = std::min(count, tail - head);
+        for (size_t i = 0; i < count; i++) {
+            items[i] = m_items[(head + i) & (Capacity - 1)];
+        }
+
+        m_head.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+    /**
+     * @brief Number of items queued, as seen from either side.
+     */
+    size_t size() const {
+        return m_tail.load(std::memory_order_acquire) - m_head.load(std::memory_order_acquire);
+    }
+
+private:
+    std::array<T, Capacity> m_items;
+
+    // Each index is written by one side only; they're kept on cache lines of their own so that the
+    // two threads don't keep stealing the line from each other
+    alignas(64) std::atomic<size_t> m_head{0};
+    alignas(64) std::atomic<size_t> m_tail{0};
+};
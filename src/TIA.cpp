@@ -27,9 +27,8 @@
  * the beam should move back to the top of the screen. Writing the value 2 to
  * the address 0x01 sends a signal to the television that the beam should move
  * to a section right above the drawing area of the screen. Writing any value to
- * the address 0x02 sends a signal to the television for the beam to finish its
- * current scanline and move to the next (as well as position the beam at the
- * beginning of the drawing section of the screen). Pixel information for
+ * the address 0x02 halts the CPU until the beam has finished its current
+ * scanline; the beam itself carries on as usual. Pixel information for
  * backgrounds and sprites are read from their respective registers and only
  * drawn when the beam is in the draw area of the screen.
  *
@@ -37,7 +36,16 @@
  * screen is divided, refer to page 2 of the Stella Programmer's Guide
  * (https://atarihq.com/danb/files/stella.pdf).
  */
+#include <algorithm>
+#include <iostream>
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define TIA_AVX2
+#include <immintrin.h>
+#endif
+
 #include "Atari.hpp"
+#include "LineMask.hpp"
 #include "TIA.hpp"
 
 /**
@@ -58,65 +66,93 @@ static inline uint8_t reverse(uint8_t b) {
     return b;
 }
 
-TIA::TIA() {
-    m_colorRom = {{
-        { olc::Pixel(0, 0, 0),       olc::Pixel(68, 68, 0),     olc::Pixel(112, 40, 0),
-          olc::Pixel(132, 24, 0),    olc::Pixel(136, 0, 0),     olc::Pixel(120, 0, 92),
-          olc::Pixel(72, 0, 120),    olc::Pixel(20, 0, 132),    olc::Pixel(0, 0, 136),
-          olc::Pixel(0, 24, 124),    olc::Pixel(0, 44, 92),     olc::Pixel(0, 60, 44),
-          olc::Pixel(0, 60, 0),      olc::Pixel(20, 56, 0),     olc::Pixel(44, 48, 0),
-          olc::Pixel(68, 40, 0) },
-        { olc::Pixel(64, 64, 64),    olc::Pixel(100, 100, 16),  olc::Pixel(132, 68, 20),
-          olc::Pixel(152, 52, 24),   olc::Pixel(156, 32, 32),   olc::Pixel(140, 32, 116),
-          olc::Pixel(96, 32, 144),   olc::Pixel(48, 32, 152),   olc::Pixel(28, 32, 156),
-          olc::Pixel(28, 56, 144),   olc::Pixel(28, 76, 120),   olc::Pixel(28, 92, 72),
-          olc::Pixel(32, 92, 32),    olc::Pixel(52, 92, 28),    olc::Pixel(76, 80, 28),
-          olc::Pixel(100, 72, 24) },
-        { olc::Pixel(108, 108, 108), olc::Pixel(132, 132, 36),  olc::Pixel(152, 92, 40),
-          olc::Pixel(172, 80, 48),   olc::Pixel(176, 60, 60),   olc::Pixel(160, 60, 136),
-          olc::Pixel(120, 60, 164),  olc::Pixel(76, 60, 172),   olc::Pixel(56, 64, 176),
-          olc::Pixel(56, 84, 168),   olc::Pixel(56, 104, 144),  olc::Pixel(56, 124, 100),
-          olc::Pixel(64, 124, 64),   olc::Pixel(80, 124, 56),   olc::Pixel(104, 112, 52),
-          olc::Pixel(132, 104, 48) } ,
-        { olc::Pixel(144, 144, 144), olc::Pixel(160, 160, 52),  olc::Pixel(172, 120, 60),
-          olc::Pixel(192, 104, 72),  olc::Pixel(192, 88, 88),   olc::Pixel(176, 88, 156),
-          olc::Pixel(140, 88, 184),  olc::Pixel(104, 88, 192),  olc::Pixel(80, 92, 192),
-          olc::Pixel(80, 112, 188),  olc::Pixel(80, 132, 172),  olc::Pixel(80, 156, 128),
-          olc::Pixel(92, 156, 92),   olc::Pixel(108, 152, 80),  olc::Pixel(132, 140, 76),
-          olc::Pixel(160, 132, 68) }, 
-        { olc::Pixel(176, 176, 176), olc::Pixel(184, 184, 64),  olc::Pixel(188, 140, 76),
-          olc::Pixel(208, 128, 92),  olc::Pixel(208, 112, 112), olc::Pixel(192, 112, 176),
-          olc::Pixel(160, 112, 204), olc::Pixel(124, 112, 208), olc::Pixel(104, 116, 208),
-          olc::Pixel(104, 136, 204), olc::Pixel(104, 156, 192), olc::Pixel(104, 180, 148),
-          olc::Pixel(116, 180, 116), olc::Pixel(132, 180, 104), olc::Pixel(156, 168, 100),
-          olc::Pixel(184, 156, 88) }, 
-        { olc::Pixel(200, 200, 200), olc::Pixel(208, 208, 80),  olc::Pixel(204, 160, 92),
-          olc::Pixel(224, 148, 112), olc::Pixel(224, 136, 136), olc::Pixel(208, 132, 192),
-          olc::Pixel(180, 132, 220), olc::Pixel(148, 136, 224), olc::Pixel(124, 140, 224),
-          olc::Pixel(124, 156, 220), olc::Pixel(124, 180, 212), olc::Pixel(124, 208, 172),
-          olc::Pixel(140, 208, 140), olc::Pixel(156, 204, 124), olc::Pixel(180, 192, 120),
-          olc::Pixel(208, 180, 108) }, 
-        { olc::Pixel(220, 220, 220), olc::Pixel(232, 232, 92),  olc::Pixel(220, 180, 104),
-          olc::Pixel(236, 168, 128), olc::Pixel(236, 160, 160), olc::Pixel(220, 156, 208),
-          olc::Pixel(196, 156, 236), olc::Pixel(168, 160, 236), olc::Pixel(144, 164, 236),
-          olc::Pixel(144, 180, 236), olc::Pixel(144, 204, 232), olc::Pixel(144, 228, 192),
-          olc::Pixel(164, 228, 164), olc::Pixel(180, 228, 144), olc::Pixel(204, 212, 136),
-          olc::Pixel(232, 204, 124) }, 
-        { olc::Pixel(244, 244, 244), olc::Pixel(252, 252, 104), olc::Pixel(236, 200, 120),
-          olc::Pixel(252, 188, 148), olc::Pixel(252, 180, 180), olc::Pixel(236, 176, 224),
-          olc::Pixel(212, 176, 252), olc::Pixel(188, 180, 252), olc::Pixel(164, 184, 252),
-          olc::Pixel(164, 200, 252), olc::Pixel(164, 224, 252), olc::Pixel(164, 252, 212),
-          olc::Pixel(184, 252, 184), olc::Pixel(200, 252, 164), olc::Pixel(224, 236, 156),
-          olc::Pixel(252, 224, 140) }
+/**
+ * @brief A color as 32-bit RGBA with red in the lowest byte, fully opaque.
+ */
+static constexpr uint32_t rgb(uint8_t r, uint8_t g, uint8_t b) {
+    return 0xFF000000 | b << 16 | g << 8 | r;
+}
+
+/**
+ * @brief The colors of the palette, indexed as getColor() indexes them.
+ */
+static constexpr std::array<uint32_t, 0x80> palette() {
+    // The palette's colors by luminosity and hue
+    constexpr std::array<std::array<uint32_t, 16>, 8> colorRom = {{
+        { rgb(0, 0, 0),       rgb(68, 68, 0),     rgb(112, 40, 0),
+          rgb(132, 24, 0),    rgb(136, 0, 0),     rgb(120, 0, 92),
+          rgb(72, 0, 120),    rgb(20, 0, 132),    rgb(0, 0, 136),
+          rgb(0, 24, 124),    rgb(0, 44, 92),     rgb(0, 60, 44),
+          rgb(0, 60, 0),      rgb(20, 56, 0),     rgb(44, 48, 0),
+          rgb(68, 40, 0) },
+        { rgb(64, 64, 64),    rgb(100, 100, 16),  rgb(132, 68, 20),
+          rgb(152, 52, 24),   rgb(156, 32, 32),   rgb(140, 32, 116),
+          rgb(96, 32, 144),   rgb(48, 32, 152),   rgb(28, 32, 156),
+          rgb(28, 56, 144),   rgb(28, 76, 120),   rgb(28, 92, 72),
+          rgb(32, 92, 32),    rgb(52, 92, 28),    rgb(76, 80, 28),
+          rgb(100, 72, 24) },
+        { rgb(108, 108, 108), rgb(132, 132, 36),  rgb(152, 92, 40),
+          rgb(172, 80, 48),   rgb(176, 60, 60),   rgb(160, 60, 136),
+          rgb(120, 60, 164),  rgb(76, 60, 172),   rgb(56, 64, 176),
+          rgb(56, 84, 168),   rgb(56, 104, 144),  rgb(56, 124, 100),
+          rgb(64, 124, 64),   rgb(80, 124, 56),   rgb(104, 112, 52),
+          rgb(132, 104, 48) } ,
+        { rgb(144, 144, 144), rgb(160, 160, 52),  rgb(172, 120, 60),
+          rgb(192, 104, 72),  rgb(192, 88, 88),   rgb(176, 88, 156),
+          rgb(140, 88, 184),  rgb(104, 88, 192),  rgb(80, 92, 192),
+          rgb(80, 112, 188),  rgb(80, 132, 172),  rgb(80, 156, 128),
+          rgb(92, 156, 92),   rgb(108, 152, 80),  rgb(132, 140, 76),
+          rgb(160, 132, 68) }, 
+        { rgb(176, 176, 176), rgb(184, 184, 64),  rgb(188, 140, 76),
+          rgb(208, 128, 92),  rgb(208, 112, 112), rgb(192, 112, 176),
+          rgb(160, 112, 204), rgb(124, 112, 208), rgb(104, 116, 208),
+          rgb(104, 136, 204), rgb(104, 156, 192), rgb(104, 180, 148),
+          rgb(116, 180, 116), rgb(132, 180, 104), rgb(156, 168, 100),
+          rgb(184, 156, 88) }, 
+        { rgb(200, 200, 200), rgb(208, 208, 80),  rgb(204, 160, 92),
+          rgb(224, 148, 112), rgb(224, 136, 136), rgb(208, 132, 192),
+          rgb(180, 132, 220), rgb(148, 136, 224), rgb(124, 140, 224),
+          rgb(124, 156, 220), rgb(124, 180, 212), rgb(124, 208, 172),
+          rgb(140, 208, 140), rgb(156, 204, 124), rgb(180, 192, 120),
+          rgb(208, 180, 108) }, 
+        { rgb(220, 220, 220), rgb(232, 232, 92),  rgb(220, 180, 104),
+          rgb(236, 168, 128), rgb(236, 160, 160), rgb(220, 156, 208),
+          rgb(196, 156, 236), rgb(168, 160, 236), rgb(144, 164, 236),
+          rgb(144, 180, 236), rgb(144, 204, 232), rgb(144, 228, 192),
+          rgb(164, 228, 164), rgb(180, 228, 144), rgb(204, 212, 136),
+          rgb(232, 204, 124) }, 
+        { rgb(244, 244, 244), rgb(252, 252, 104), rgb(236, 200, 120),
+          rgb(252, 188, 148), rgb(252, 180, 180), rgb(236, 176, 224),
+          rgb(212, 176, 252), rgb(188, 180, 252), rgb(164, 184, 252),
+          rgb(164, 200, 252), rgb(164, 224, 252), rgb(164, 252, 212),
+          rgb(184, 252, 184), rgb(200, 252, 164), rgb(224, 236, 156),
+          rgb(252, 224, 140) }
     }};
+
+    std::array<uint32_t, 0x80> colors = {};
+    for (int color = 0; color < 0x100; color += 2) {
+        colors[color >> 1] = colorRom[(color & 0x0F) >> 1][color >> 4];
+    }
+    return colors;
 }
 
+static constexpr std::array<uint32_t, 0x80> s_palette = palette();
+
+TIA::TIA() = default;
+
 TIA::~TIA() = default;
 
 void TIA::connectAtari(Atari* atari) {
     m_atari = atari;
 }
 
+/**
+ * @brief Hand every frame completed from now on to the given sink, none if it's null.
+ */
+void TIA::connectVideo(VideoSink* video) {
+    m_video = video;
+}
+
 /**
  * @brief Reset beam position to its initial location; reset state to VSYNC.
  */
@@ -124,179 +160,741 @@ void TIA::reset() {
     m_beamX = 0;
     m_beamY = 0;
     m_state = TIA_VSYNC;
+    m_events.clear();
+    m_nextEvent = 0;
+    m_vsyncQueued = m_regs[VSYNC];
+    m_frameEnd = NO_FRAME_END;
+    m_frameCounter = 0;
+    m_frameLines = 0;
+    m_partialFrame = true;
+    m_stale = STALE_ALL;
 }
 
 /**
- * @brief Getter for the sprites that make up the screen.
+ * Snapshot the TIA's state. Meant to be taken once the TIA has caught up with the CPU (see
+ * Atari::save()), when the only writes still queued are the few due on the current clock.
+ * @return false if more writes are queued than the snapshot holds
  */
-olc::Sprite& TIA::getScreen() {
-    return m_sprScreen;
+bool TIA::save(State& state) const {
+    size_t events = m_events.size() - m_nextEvent;
+
+    if (events > STATE_EVENTS) {
+        return false;
+    }
+
+    state.clocks = m_clocks;
+    state.frameEnd = m_frameEnd;
+    state.frameCounter = m_frameCounter;
+    state.frameLines = m_frameLines;
+    state.beamY = m_beamY;
+    state.beamX = m_beamX;
+    state.state = m_state;
+    state.frameDone = m_frameDone;
+    state.vsyncQueued = m_vsyncQueued;
+    state.regs = m_regs;
+    state.positions = { m_p0x, m_p1x, m_m0x, m_m1x, m_blx };
+    state.strobes = { m_resp0, m_resp1, m_resm0, m_resm1, m_resbl, m_hmove, m_hmclr };
+    state.eventCount = events;
+    std::copy(m_events.begin() + m_nextEvent, m_events.end(), state.events.begin());
+    m_audio.save(state.audio);
+    return true;
 }
 
 /**
- * @brief Given a color variable, break it into luminosity and color to index into the color ROM.
- * @return The color from the Atari 2600's palette for the given luminosity and color
+ * @brief Restore a snapshot taken by save(). What was drawn of the frame so far is kept, to be
+ * drawn over from the restored beam position on.
  */
-inline olc::Pixel& TIA::getColor(uint8_t color) {
-    return m_colorRom[(color & 0x0F) >> 1][color >> 4];
+void TIA::load(const State& state) {
+    m_clocks = state.clocks;
+    m_frameEnd = state.frameEnd;
+    m_frameCounter = state.frameCounter;
+    m_frameLines = state.frameLines;
+    m_beamY = state.beamY;
+    m_beamX = state.beamX;
+    m_state = static_cast<decltype(m_state)>(state.state);
+    m_frameDone = state.frameDone;
+    m_vsyncQueued = state.vsyncQueued;
+    m_regs = state.regs;
+
+    m_p0x = state.positions[0];
+    m_p1x = state.positions[1];
+    m_m0x = state.positions[2];
+    m_m1x = state.positions[3];
+    m_blx = state.positions[4];
+
+    m_resp0 = state.strobes[0];
+    m_resp1 = state.strobes[1];
+    m_resm0 = state.strobes[2];
+    m_resm1 = state.strobes[3];
+    m_resbl = state.strobes[4];
+    m_hmove = state.strobes[5];
+    m_hmclr = state.strobes[6];
+    m_partialFrame = true;
+    m_stale = STALE_ALL;
+
+    m_events.assign(state.events.begin(), state.events.begin() + state.eventCount);
+    m_nextEvent = 0;
+    m_audio.load(state.audio);
 }
 
 /**
- * @brief Whenever the electron beam is in the draw section of the screen, draw the
- * playfield/background of the ROM. The playfield is a 20-bit value which represents pixels that
- * are either the playfield's color or the background's color. This 20-bit value only covers half
- * of the screen; the second half of the screen is determined by the value in the CTRLPF register.
- * If this value is 1, then the right half of the screen is a mirror of the left half; otherwise,
- * the right half is the same as the left half.
+ * @brief The screen as the palette index of each pixel (see getColor()), WIDTH * HEIGHT bytes.
+ * Cheaper than expanding it for whatever doesn't need actual colors, such as hashing frames.
  */
-void TIA::drawPlayfield() {
-    uint8_t colupf;
-    uint32_t line = reverse(m_atari->read8(PF2)) | (m_atari->read8(PF1) << 8)
-        | (reverse(m_atari->read8(PF0)) << 16);
-    uint8_t colubk = m_atari->read8(COLUBK);
-    uint16_t y = m_beamY - 40;
+const uint8_t* TIA::getFrame() const {
+    return m_frame.data();
+}
 
-    if (m_atari->read8(CTRLPF) & 0x02) {
-        // Scoreboard mode
-        colupf = m_atari->read8(COLUP0);
-    } else {
-        colupf = m_atari->read8(COLUPF);
+/**
+ * @brief Scalar version of expandAvx2().
+ */
+static void expandScalar(const uint8_t* frame, const uint32_t* palette, uint32_t* pixels,
+        size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        pixels[i] = palette[frame[i]];
     }
+}
 
-    olc::Pixel pfColor = getColor(colupf);
-    olc::Pixel bgColor = getColor(colubk);
+#ifdef TIA_AVX2
+/**
+ * @brief Look the colors of the given palette indices up, eight pixels at a time. The count has to
+ * be a multiple of 8.
+ */
+__attribute__((target("avx2")))
+static void expandAvx2(const uint8_t* frame, const uint32_t* palette, uint32_t* pixels,
+        size_t count) {
+    for (size_t i = 0; i < count; i += 8) {
+        __m256i indices = _mm256_cvtepu8_epi32(
+            _mm_loadl_epi64(reinterpret_cast<const __m128i*>(frame + i)));
+        __m256i colors = _mm256_i32gather_epi32(reinterpret_cast<const int*>(palette), indices,
+            4);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pixels + i), colors);
+    }
+}
+#endif
+
+/**
+ * @brief Look the colors of a frame's palette indices (see VideoSink) up, WIDTH * HEIGHT pixels
+ * as 32-bit RGBA with red in the lowest byte, ready to be displayed.
+ */
+void TIA::expand(const uint8_t* frame, uint32_t* pixels) {
+#ifdef TIA_AVX2
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    if (avx2) {
+        expandAvx2(frame, s_palette.data(), pixels, WIDTH * HEIGHT);
+        return;
+    }
+#endif
+
+    expandScalar(frame, s_palette.data(), pixels, WIDTH * HEIGHT);
+}
+
+/**
+ * @brief Given a color variable, drop the unused lowest bit to index into the palette. The
+ * remaining bits are the luminosity and, above it, the hue.
+ * @return The index of the color in the palette
+ */
+static inline uint8_t getColor(uint8_t color) {
+    return color >> 1;
+}
+
+/**
+ * Pixels covered by an object whose copy covers the given pattern (pixel 0 in bit 0), relative
+ * to the object's position, for each number/size mode of NUSIZ (bits 0-2): one copy, two copies
+ * 16 (close), 32 (medium) or 64 (wide) pixels apart, three copies close or medium apart, or one
+ * copy of a player stretched to twice or four times its width (modes 5 and 7). Missiles are never
+ * stretched.
+ */
+static constexpr LineMask copies(uint8_t nusiz, uint64_t pattern) {
+    LineMask mask(pattern, 0, 0);
+
+    switch (nusiz & 0x07) {
+        case 1: return mask | mask.shiftLeft(16);
+        case 2: return mask | mask.shiftLeft(32);
+        case 3: return mask | mask.shiftLeft(16) | mask.shiftLeft(32);
+        case 4: return mask | mask.shiftLeft(64);
+        case 6: return mask | mask.shiftLeft(32) | mask.shiftLeft(64);
+        default: return mask;
+    }
+}
+
+/**
+ * @brief Table of the pixels a player covers for each NUSIZ mode and graphics in the order they're
+ * drawn (bit 0 first), relative to the player's position.
+ */
+static constexpr std::array<std::array<LineMask, 0x100>, 8> playerPixels() {
+    std::array<std::array<LineMask, 0x100>, 8> table = {};
 
-    // Draw the left half of the screen
-    for (int i = 19; i >= 0; i--) {
-        olc::Pixel color = (line >> i) & 0x01 ? pfColor : bgColor;
-        m_sprScreen.SetPixel((19 - i) * 4, y, color);
-        m_sprScreen.SetPixel((19 - i) * 4 + 1, y, color);
-        m_sprScreen.SetPixel((19 - i) * 4 + 2, y, color);
-        m_sprScreen.SetPixel((19 - i) * 4 + 3, y, color);
+    for (int nusiz = 0; nusiz < 8; nusiz++) {
+        int stretch = nusiz == 5 ? 2 : nusiz == 7 ? 4 : 1;
+
+        for (int graphics = 0; graphics < 0x100; graphics++) {
+            uint64_t pattern = 0;
+            for (int i = 0; i < 8; i++) {
+                if ((graphics >> i) & 0x01) {
+                    pattern |= ((1ull << stretch) - 1) << (i * stretch);
+                }
+            }
+            table[nusiz][graphics] = copies(nusiz, pattern);
+        }
     }
 
-    if (m_atari->read8(CTRLPF) & 0x01) {
-        // Mirror right side of the screen
-        line = (m_atari->read8(PF0) >> 4) | (reverse(m_atari->read8(PF1)) << 4)
-            | (m_atari->read8(PF2) << 12);
+    return table;
+}
+
+/**
+ * @brief Table of the pixels a missile covers for each NUSIZ mode and size (NUSIZ bits 4-5, 1 to
+ * 8 pixels wide), relative to the missile's position. The ball is a missile with NUSIZ mode 0.
+ */
+static constexpr std::array<std::array<LineMask, 4>, 8> missilePixels() {
+    std::array<std::array<LineMask, 4>, 8> table = {};
+
+    for (int nusiz = 0; nusiz < 8; nusiz++) {
+        for (int size = 0; size < 4; size++) {
+            bool stretched = nusiz == 5 || nusiz == 7;
+            table[nusiz][size] = copies(stretched ? 0 : nusiz, (1 << (1 << size)) - 1);
+        }
     }
-    if (m_atari->read8(CTRLPF) & 0x02) {
-        // Scoreboard mode
-        colupf = m_atari->read8(COLUP1);
-        pfColor = getColor(colupf);
+
+    return table;
+}
+
+static constexpr std::array<std::array<LineMask, 0x100>, 8> s_players = playerPixels();
+static constexpr std::array<std::array<LineMask, 4>, 8> s_missiles = missilePixels();
+
+/**
+ * @brief Pixels covered by a player, its graphics being drawn from bit 7 unless reflected.
+ */
+static inline LineMask player(uint8_t graphics, bool reflected, uint8_t nusiz, uint8_t position) {
+    return s_players[nusiz & 0x07][reflected ? graphics : reverse(graphics)].rotate(position);
+}
+
+/**
+ * @brief Pixels covered by a missile (or the ball, with CTRLPF's size bits for NUSIZ) while
+ * enabled, none otherwise.
+ */
+static inline LineMask missile(uint8_t enable, uint8_t nusiz, uint8_t position) {
+    if (!(enable & 0x02)) {
+        return LineMask();
     }
+    return s_missiles[nusiz & 0x07][(nusiz >> 4) & 0x03].rotate(position);
+}
 
-    // Draw other the other half of the screen
-    for (int i = 19; i >= 0; i--) {
-        olc::Pixel color = (line >> i) & 0x01 ? pfColor : bgColor;
-        m_sprScreen.SetPixel(WIDTH / 2 + (19 - i) * 4, y, color);
-        m_sprScreen.SetPixel(WIDTH / 2 + (19 - i) * 4 + 1, y, color);
-        m_sprScreen.SetPixel(WIDTH / 2 + (19 - i) * 4 + 2, y, color);
-        m_sprScreen.SetPixel(WIDTH / 2 + (19 - i) * 4 + 3, y, color);
+/**
+ * @brief Table of the pixels each value of a playfield register covers, when its bits are drawn
+ * from the least (lsbFirst) or most significant one onwards. Each bit covers 4 pixels, the first
+ * one drawn being pixels 0-3.
+ */
+static constexpr std::array<uint32_t, 0x100> playfieldPixels(bool lsbFirst) {
+    std::array<uint32_t, 0x100> table = {};
+
+    for (int value = 0; value < 0x100; value++) {
+        for (int i = 0; i < 8; i++) {
+            if ((value >> (lsbFirst ? i : 7 - i)) & 0x01) {
+                table[value] |= 0x0Fu << (i * 4);
+            }
+        }
     }
+
+    return table;
 }
 
+static constexpr std::array<uint32_t, 0x100> s_pfLsbFirst = playfieldPixels(true);
+static constexpr std::array<uint32_t, 0x100> s_pfMsbFirst = playfieldPixels(false);
+
 /**
- * @brief Whenever the TIA beam is in the draw state, draw the sprite for player 0 whose x position
- * is determined by the beam's x position.
+ * Pixels of the current line covered by the playfield. The left half is PF0's upper nibble from
+ * bit 4, PF1 from bit 7 and PF2 from bit 0 (pixels 0-15, 16-47 and 48-79). The right half repeats
+ * it, or mirrors it when CTRLPF bit 0 is set: PF2 from bit 7, PF1 from bit 0 and PF0 from bit 7.
  */
-void TIA::drawPlayer0() {
-    uint8_t sprite;
-    uint8_t colup0 = m_atari->read8(COLUP0);
-    olc::Pixel spriteColor = getColor(colup0);
-    uint16_t y = m_beamY - 40;
+LineMask TIA::playfield(uint8_t ctrlpf) const {
+    uint64_t pf0 = s_pfLsbFirst[m_regs[PF0] >> 4];
+    uint64_t pf1 = s_pfMsbFirst[m_regs[PF1]];
+    uint64_t pf2 = s_pfLsbFirst[m_regs[PF2]];
+
+    uint64_t low = pf0 | (pf1 << 16) | (pf2 << 48);
+    uint64_t middle = pf2 >> 16;
+    uint64_t high;
 
-    if (m_atari->read8(REFP0) & 0x10) {
-        sprite = m_atari->read8(GRP0);
+    if (ctrlpf & 0x01) {
+        uint64_t reflected1 = s_pfLsbFirst[m_regs[PF1]];
+        middle |= (uint64_t) s_pfMsbFirst[m_regs[PF2]] << 16 | reflected1 << 48;
+        high = reflected1 >> 16 | (s_pfMsbFirst[m_regs[PF0]] & 0xFFFF) << 16;
     } else {
-        sprite = reverse(m_atari->read8(GRP0));
+        middle |= pf0 << 16 | pf1 << 32;
+        high = pf2;
     }
 
-    for (int i = 0; i < 8; i++) {
-        olc::Pixel color = (sprite >> i ) & 0x01 ? spriteColor
-            : m_sprScreen.GetPixel((m_p0x + i) % WIDTH, y);
-        m_sprScreen.SetPixel((m_p0x + i) % WIDTH, y, color);
+    return LineMask(low, middle, high);
+}
+
+#ifndef TIA_AVX2
+/**
+ * @brief Scalar version of expandPlayfieldAvx2().
+ */
+static void expandPlayfieldScalar(const LineMask& pf, uint8_t left, uint8_t right,
+        uint8_t background, uint8_t* pixels) {
+    for (uint8_t x = 0; x < WIDTH; x++) {
+        pixels[x] = pf.test(x) ? (x < WIDTH / 2 ? left : right) : background;
+    }
+}
+#else
+// Each byte selecting the bit of its pixel, out of the byte of the mask broadcast to it
+#define PIXEL_BITS 0x8040201008040201ll
+
+// Bytes of the mask broadcast to every byte of a 64-bit word
+#define BROADCAST(mask, byte) ((((mask) >> ((byte) * 8)) & 0xFF) * 0x0101010101010101ull)
+
+/**
+ * @brief SSE2 version of expandPlayfieldAvx2(), 16 pixels at a time. SSE2 comes with x86-64, so
+ * this is the fallback wherever AVX2 isn't there.
+ */
+static void expandPlayfieldSse2(const LineMask& pf, uint8_t left, uint8_t right,
+        uint8_t background, uint8_t* pixels) {
+    const __m128i bits = _mm_set1_epi64x(PIXEL_BITS);
+    const __m128i back = _mm_set1_epi8(background);
+
+    for (int x = 0; x < WIDTH; x += 16) {
+        uint64_t mask = pf.word(x / 64) >> (x % 64);
+        __m128i bytes = _mm_set_epi64x(BROADCAST(mask, 1), BROADCAST(mask, 0));
+        __m128i set = _mm_cmpeq_epi8(_mm_and_si128(bytes, bits), bits);
+        __m128i fore = _mm_set1_epi8(x < WIDTH / 2 ? left : right);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(pixels + x),
+            _mm_or_si128(_mm_and_si128(set, fore), _mm_andnot_si128(set, back)));
     }
 }
 
 /**
- * @brief Whenever the TIA beam is in the draw state, draw the sprite for player 1 whose x position
- * is determined by the beam's x position.
+ * @brief Expand the playfield's pixels into the palette indices of the whole line, the given
+ * color of its half where the playfield is and the background elsewhere; 32 pixels at a time.
  */
-void TIA::drawPlayer1() {
-    uint8_t sprite;
-    uint8_t colup1 = m_atari->read8(COLUP1);
-    olc::Pixel spriteColor = getColor(colup1);
-    uint16_t y = m_beamY - 40;
+__attribute__((target("avx2")))
+static void expandPlayfieldAvx2(const LineMask& pf, uint8_t left, uint8_t right,
+        uint8_t background, uint8_t* pixels) {
+    const __m256i bits = _mm256_set1_epi64x(PIXEL_BITS);
+    const __m256i back = _mm256_set1_epi8(background);
+
+    for (int x = 0; x < WIDTH; x += 32) {
+        uint64_t mask = pf.word(x / 64) >> (x % 64);
+        __m256i bytes = _mm256_set_epi64x(BROADCAST(mask, 3), BROADCAST(mask, 2),
+            BROADCAST(mask, 1), BROADCAST(mask, 0));
+        __m256i set = _mm256_cmpeq_epi8(_mm256_and_si256(bytes, bits), bits);
+
+        // The halves of the line meet on a 16 pixel boundary
+        __m256i fore = _mm256_setr_m128i(_mm_set1_epi8(x < WIDTH / 2 ? left : right),
+            _mm_set1_epi8(x + 16 < WIDTH / 2 ? left : right));
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(pixels + x),
+            _mm256_or_si256(_mm256_and_si256(set, fore), _mm256_andnot_si256(set, back)));
+    }
+}
+#endif
 
-    if (m_atari->read8(REFP1) & 0x10) {
-        sprite = m_atari->read8(GRP1);
+/**
+ * @brief Expand the playfield's pixels into palette indices with the best kernel the CPU runs.
+ */
+static void expandPlayfield(const LineMask& pf, uint8_t left, uint8_t right, uint8_t background,
+        uint8_t* pixels) {
+#ifdef TIA_AVX2
+    static const bool avx2 = __builtin_cpu_supports("avx2");
+    if (avx2) {
+        expandPlayfieldAvx2(pf, left, right, background, pixels);
     } else {
-        sprite = reverse(m_atari->read8(GRP1));
+        expandPlayfieldSse2(pf, left, right, background, pixels);
+    }
+#else
+    expandPlayfieldScalar(pf, left, right, background, pixels);
+#endif
+}
+
+/**
+ * Draw the pixels from..to - 1 of the current line with the registers as they are now, i.e. the
+ * pixels the beam passes while nothing changes. Each pixel is drawn once, when the beam reaches
+ * it: the playfield/background first, then player 0, player 1, missile 0, missile 1 and the ball
+ * on top of each other. With CTRLPF bit 2 set, the playfield goes over the players and missiles
+ * instead.
+ *
+ * The playfield is a 20-bit value which represents pixels that are either the playfield's color
+ * or the background's color. This 20-bit value only covers half of the screen; the second half of
+ * the screen is determined by the value in the CTRLPF register. If this value is 1, then the right
+ * half of the screen is a mirror of the left half; otherwise, the right half is the same as the
+ * left half. In scoreboard mode, each half takes the color of the player on its side.
+ *
+ * The pixels each object covers are worked out for the whole line at once, so the collisions
+ * between all of them within the span come down to a few ANDs of those masks, and each object only
+ * visits the pixels it covers. The masks and the playfield expanded into colors are kept from one
+ * span to the next, and only worked out again for the objects whose registers or position changed
+ * in between, so the many short spans of a line being written to cost little more than the copy.
+ */
+void TIA::drawSpan(uint8_t from, uint8_t to) {
+    uint8_t* line = m_frame.data() + (m_beamY - 40) * WIDTH;
+    uint8_t ctrlpf = m_regs[CTRLPF];
+
+    bool scoreboard = ctrlpf & 0x02;
+    uint8_t leftColor = getColor(m_regs[scoreboard ? COLUP0 : COLUPF]);
+    uint8_t rightColor = getColor(m_regs[scoreboard ? COLUP1 : COLUPF]);
+    uint8_t backgroundColor = getColor(m_regs[COLUBK]);
+    uint8_t p0Color = getColor(m_regs[COLUP0]);
+    uint8_t p1Color = getColor(m_regs[COLUP1]);
+    uint8_t ballColor = getColor(m_regs[COLUPF]);
+
+    if (m_stale) {
+        updateMasks();
     }
 
-    for (int i = 0; i < 8; i++) {
-        olc::Pixel color = (sprite >> i) & 0x01 ? spriteColor
-            : m_sprScreen.GetPixel((m_p1x + i) % WIDTH, y);
-        m_sprScreen.SetPixel((m_p1x + i) % WIDTH, y, color);
+    uint8_t rowColors[3] = { leftColor, rightColor, backgroundColor };
+    if ((m_stale & STALE_PF) || !std::equal(rowColors, rowColors + 3, m_pfRowColors)) {
+        expandPlayfield(m_pfMask, leftColor, rightColor, backgroundColor, m_pfRow.data());
+        std::copy(rowColors, rowColors + 3, m_pfRowColors);
     }
+    m_stale = 0;
+
+    LineMask span = LineMask::range(from, to);
+    LineMask pf = m_pfMask & span;
+    LineMask p0 = m_p0Mask & span;
+    LineMask p1 = m_p1Mask & span;
+    LineMask m0 = m_m0Mask & span;
+    LineMask m1 = m_m1Mask & span;
+    LineMask bl = m_blMask & span;
+
+    latchCollisions(pf, p0, p1, m0, m1, bl);
+
+    std::copy(m_pfRow.begin() + from, m_pfRow.begin() + to, line + from);
+
+    p0.forEach([&](uint8_t x) { line[x] = p0Color; });
+    p1.forEach([&](uint8_t x) { line[x] = p1Color; });
+    m0.forEach([&](uint8_t x) { line[x] = p0Color; });
+    m1.forEach([&](uint8_t x) { line[x] = p1Color; });
+    if (ctrlpf & 0x04) {
+        pf.forEach([&](uint8_t x) { line[x] = m_pfRow[x]; });
+    }
+    bl.forEach([&](uint8_t x) { line[x] = ballColor; });
 }
 
 /**
- * @brief Whenever the TIA beam is in the draw state, draw the sprite for missile 0 whose x
- * position is determined by the beam's x position.
+ * @brief Work out again the pixels of the line covered by each object whose registers or position
+ * changed since the last span.
  */
-void TIA::drawMissile0() {
-    if (!(m_atari->read8(ENAM0) & 0x02)) {
-        return;
+void TIA::updateMasks() {
+    uint8_t ctrlpf = m_regs[CTRLPF];
+
+    if (m_stale & STALE_PF) {
+        m_pfMask = playfield(ctrlpf);
+    }
+    if (m_stale & STALE_P0) {
+        m_p0Mask = player(m_regs[GRP0], m_regs[REFP0] & 0x10, m_regs[NUSIZ0], m_p0x);
+    }
+    if (m_stale & STALE_P1) {
+        m_p1Mask = player(m_regs[GRP1], m_regs[REFP1] & 0x10, m_regs[NUSIZ1], m_p1x);
     }
+    if (m_stale & STALE_M0) {
+        m_m0Mask = missile(m_regs[ENAM0], m_regs[NUSIZ0], m_m0x);
+    }
+    if (m_stale & STALE_M1) {
+        m_m1Mask = missile(m_regs[ENAM1], m_regs[NUSIZ1], m_m1x);
+    }
+    if (m_stale & STALE_BL) {
+        m_blMask = missile(m_regs[ENABL], ctrlpf & 0x30, m_blx);
+    }
+}
 
-    uint16_t y = m_beamY - 40;
-    uint8_t colup0 = m_atari->read8(COLUP0);
-    olc::Pixel color = getColor(colup0);
-    uint8_t size = 1 << ((m_atari->read8(NUSIZ0) >> 4) & 0x03);
+/**
+ * @brief Set the collision latches of every pair of objects which overlap on the given masks.
+ * Each CX register holds two latches, in bits 7 and 6.
+ */
+void TIA::latchCollisions(const LineMask& pf, const LineMask& p0, const LineMask& p1,
+        const LineMask& m0, const LineMask& m1, const LineMask& bl) {
+    auto latch = [this](uint8_t reg, const LineMask& a, const LineMask& b, const LineMask& c,
+            const LineMask& d) {
+        m_regs[reg] |= ((a & b).any() << 7) | ((c & d).any() << 6);
+    };
 
-    for (int i = 0; i < size; i++) {
-        m_sprScreen.SetPixel((m_m0x + i) % WIDTH, y, color);
+    latch(CXM0P, m0, p1, m0, p0);
+    latch(CXM1P, m1, p0, m1, p1);
+    latch(CXP0FB, p0, pf, p0, bl);
+    latch(CXP1FB, p1, pf, p1, bl);
+    latch(CXM0FB, m0, pf, m0, bl);
+    latch(CXM1FB, m1, pf, m1, bl);
+    latch(CXBLPF, bl, pf, LineMask(), LineMask());
+    latch(CXPPMM, p0, p1, m0, m1);
+}
+
+/**
+ * @brief Queue up a write to a register, to be applied before the given color clock is run. The
+ * writes have to arrive in the order of their clocks, none before the TIA's current clock.
+ */
+void TIA::write(uint64_t clock, uint8_t reg, uint8_t value) {
+    m_events.push_back({ clock, reg, value });
+    if (reg == VSYNC) {
+        if ((value & 0x02) && !(m_vsyncQueued & 0x02) && m_frameEnd == NO_FRAME_END) {
+            m_frameEnd = clock;
+        }
+        m_vsyncQueued = value;
     }
 }
 
 /**
- * @brief Whenever the TIA beam is in the draw state, draw the sprite for missile 1 whose x
- * position is determined by the beam's x position.
+ * @brief Apply the queued writes which are due at the current clock.
  */
-void TIA::drawMissile1() {
-    if (!(m_atari->read8(ENAM1) & 0x02)) {
-        return;
+void TIA::applyEvents() {
+    while (m_nextEvent < m_events.size() && m_events[m_nextEvent].clock <= m_clocks) {
+        const Event& event = m_events[m_nextEvent++];
+
+        (this->*s_writes[event.reg])(event.reg, event.value);
+        m_stale |= s_masks[event.reg];
+    }
+
+    // Start over once everything is applied, or drop what is once it piles up behind writes which
+    // keep coming due at the clock the TIA is caught up to
+    if (m_nextEvent == m_events.size()) {
+        m_events.clear();
+        m_nextEvent = 0;
+    } else if (m_nextEvent >= APPLIED_EVENTS) {
+        m_events.erase(m_events.begin(), m_events.begin() + m_nextEvent);
+        m_nextEvent = 0;
     }
+}
+
+void TIA::store(uint8_t reg, uint8_t value) {
+    m_regs[reg] = value;
+}
 
-    uint16_t y = m_beamY - 40;
-    uint8_t colup1 = m_atari->read8(COLUP1);
-    olc::Pixel color = getColor(colup1);
-    uint8_t size = 1 << ((m_atari->read8(NUSIZ1) >> 4) & 0x03);
+/**
+ * @brief Write an address past CXCLR, which the TIA doesn't decode on writes. Its read registers
+ * (the collision latches and inputs) share these addresses, and are left alone.
+ */
+void TIA::ignore(uint8_t, uint8_t) {
+}
 
-    for (int i = 0; i < size; i++) {
-        m_sprScreen.SetPixel((m_m1x + i) % WIDTH, y, color);
+/**
+ * Write VSYNC, whose edges delimit frames. Asserting it (setting bit 1) starts the vertical
+ * retrace: the frame is complete and the beam goes back to the top. Releasing it ends the retrace,
+ * which leaves the beam at the start of vertical blank however long the game kept it asserted.
+ */
+void TIA::writeVsync(uint8_t reg, uint8_t value) {
+    uint8_t previous = m_regs[VSYNC];
+    m_regs[reg] = value;
+
+    if ((value & 0x02) && !(previous & 0x02)) {
+        endFrame(false);
+        m_frameEnd = nextFrameEnd();
+    } else if (!(value & 0x02) && (previous & 0x02) && m_state == TIA_VSYNC) {
+        m_beamY = 3;
+        m_state = TIA_VBLANK;
     }
 }
 
 /**
- * @brief Whenever the TIA beam is in the draw state, draw the sprite for the ball whose x
- * position is determined by the beam's x position.
+ * @brief Write one of the sound registers, once the sound up to this clock has been generated
+ * with their previous values.
  */
-void TIA::drawBall() {
-    if (!(m_atari->read8(ENABL) & 0x02)) {
-        return;
+void TIA::writeAudio(uint8_t reg, uint8_t value) {
+    m_audio.run(m_clocks);
+    m_regs[reg] = value;
+    m_audio.write(reg, value);
+}
+
+/**
+ * Complete the current frame, account for it in the frame statistics and send the beam back to
+ * the top. Until then the beam stays below the screen however many lines the game runs, so a frame
+ * is never drawn over by the next one before it's presented. The first frame after a reset or a
+ * load is left out of the statistics: it didn't start with the game's VSYNC, so its scanlines say
+ * nothing about the game's timing.
+ * @param watchdog Whether the frame is ended by the watchdog rather than by VSYNC
+ */
+void TIA::endFrame(bool watchdog) {
+    FrameStats& stats = m_frameStats;
+
+    if (!m_partialFrame) {
+        stats.jitter = stats.frames ? (int32_t) (m_frameLines - stats.scanlines) : 0;
+        stats.scanlines = m_frameLines;
+        stats.minScanlines = std::min(stats.minScanlines, m_frameLines);
+        stats.maxScanlines = std::max(stats.maxScanlines, m_frameLines);
+        stats.frames++;
+        stats.watchdogFrames += watchdog;
     }
+    m_partialFrame = false;
+
+    m_audio.run(m_clocks);
+
+    if (m_video) {
+        m_video->presentFrame(m_frame.data());
+    }
+
+    m_frameDone = true;
+    m_frameCounter = 0;
+    m_frameLines = 0;
+    m_beamY = 0;
+    m_state = TIA_VSYNC;
+}
 
-    uint16_t y = m_beamY - 40;
-    uint8_t colupf = m_atari->read8(COLUPF);
-    olc::Pixel color = getColor(colupf);
-    uint8_t size = 1 << ((m_atari->read8(CTRLPF) >> 4) & 0x03);
+/**
+ * @brief Clock of the first write still queued which asserts VSYNC, NO_FRAME_END if none.
+ */
+uint64_t TIA::nextFrameEnd() const {
+    uint8_t vsync = m_regs[VSYNC];
 
-    for (int i = 0; i < size; i++) {
-        m_sprScreen.SetPixel((m_blx + i) % WIDTH, y, color);
+    for (size_t i = m_nextEvent; i < m_events.size(); i++) {
+        if (m_events[i].reg == VSYNC) {
+            if ((m_events[i].value & 0x02) && !(vsync & 0x02)) {
+                return m_events[i].clock;
+            }
+            vsync = m_events[i].value;
+        }
     }
+
+    return NO_FRAME_END;
+}
+
+/**
+ * @brief Write a strobe register: the value is stored and its respective boolean is set for step()
+ * to act on.
+ */
+template <uint8_t TIA::*Strobe>
+void TIA::strobe(uint8_t reg, uint8_t value) {
+    m_regs[reg] = value;
+    this->*Strobe = 1;
+}
+
+void TIA::clearCollisions(uint8_t reg, uint8_t value) {
+    m_regs[reg] = value;
+    std::fill(m_regs.begin() + CXM0P, m_regs.begin() + CXPPMM + 1, 0x00);
+}
+
+constexpr std::array<TIA::RegisterWrite, 0x40> TIA::registerWrites() {
+    std::array<RegisterWrite, 0x40> table = {};
+
+    for (RegisterWrite& write : table) {
+        write = &TIA::store;
+    }
+
+    table[VSYNC] = &TIA::writeVsync;
+    for (uint8_t reg = AUDC0; reg <= AUDV1; reg++) {
+        table[reg] = &TIA::writeAudio;
+    }
+    table[RESP0] = &TIA::strobe<&TIA::m_resp0>;
+    table[RESP1] = &TIA::strobe<&TIA::m_resp1>;
+    table[RESM0] = &TIA::strobe<&TIA::m_resm0>;
+    table[RESM1] = &TIA::strobe<&TIA::m_resm1>;
+    table[RESBL] = &TIA::strobe<&TIA::m_resbl>;
+    table[HMOVE] = &TIA::strobe<&TIA::m_hmove>;
+    table[HMCLR] = &TIA::strobe<&TIA::m_hmclr>;
+    table[CXCLR] = &TIA::clearCollisions;
+    for (uint8_t reg = CXCLR + 1; reg < 0x40; reg++) {
+        table[reg] = &TIA::ignore;
+    }
+    return table;
+}
+
+const std::array<TIA::RegisterWrite, 0x40> TIA::s_writes = registerWrites();
+
+constexpr std::array<uint8_t, 0x40> TIA::registerMasks() {
+    std::array<uint8_t, 0x40> table = {};
+
+    table[NUSIZ0] = STALE_P0 | STALE_M0;
+    table[NUSIZ1] = STALE_P1 | STALE_M1;
+    table[CTRLPF] = STALE_PF | STALE_BL;
+    table[REFP0] = STALE_P0;
+    table[REFP1] = STALE_P1;
+    table[PF0] = STALE_PF;
+    table[PF1] = STALE_PF;
+    table[PF2] = STALE_PF;
+    table[GRP0] = STALE_P0;
+    table[GRP1] = STALE_P1;
+    table[ENAM0] = STALE_M0;
+    table[ENAM1] = STALE_M1;
+    table[ENABL] = STALE_BL;
+    return table;
+}
+
+const std::array<uint8_t, 0x40> TIA::s_masks = registerMasks();
+
+/**
+ * Run the TIA for up to the given number of color clocks in one batch. The batch is cut short
+ * right after the clock on which a frame completes so that the frame can be presented.
+ *
+ * Rather than stepping clock by clock, the TIA jumps from one event to the next: a queued register
+ * write, a strobe to act on, or the beam entering another part of the screen. In between, all that
+ * happens is the beam moving along the line.
+ * @return Number of color clocks actually run
+ */
+uint32_t TIA::run(uint32_t clocks) {
+    bool frameDone = m_frameDone;
+    uint32_t ran = 0;
+
+    while (ran < clocks && !(m_frameDone && !frameDone)) {
+        applyEvents();
+
+        uint32_t span = std::min(clocks - ran, clocksUntilChange());
+        if (m_nextEvent < m_events.size()) {
+            span = static_cast<uint32_t>(std::min<uint64_t>(span,
+                m_events[m_nextEvent].clock - m_clocks));
+        }
+
+        if (span) {
+            advance(span);
+            ran += span;
+        } else {
+            step();
+            ran++;
+        }
+    }
+
+    return ran;
+}
+
+/**
+ * @brief Number of clocks from here on which only move the beam along the current part of the
+ * line, i.e. which step() would run without anything else happening.
+ */
+uint32_t TIA::clocksUntilChange() const {
+    if (m_resp0 || m_resp1 || m_resm0 || m_resm1 || m_resbl || m_hmove || m_hmclr) {
+        return 0;
+    }
+
+    int clocks = FRAME_WATCHDOG - 1 - m_frameCounter;
+    int end = m_state == TIA_HBLANK ? 68 : 228;
+
+    return std::max(0, std::min(clocks, end - 1 - m_beamX));
+}
+
+/**
+ * @brief Move the beam the given number of clocks along the current part of the line (see
+ * clocksUntilChange()).
+ */
+void TIA::advance(uint32_t clocks) {
+    m_clocks += clocks;
+    m_frameCounter += clocks;
+    if (m_state == TIA_DRAW) {
+        drawSpan(m_beamX - 68, m_beamX - 68 + clocks);
+    }
+
+    m_beamX += clocks;
+}
+
+/**
+ * @brief Number of color clocks until the beam reaches the start of the next line, i.e. the end of
+ * the CPU's halt when it writes WSYNC now.
+ */
+uint32_t TIA::clocksUntilLineEnd() const {
+    return 228 - m_beamX;
+}
+
+/**
+ * Return a lower bound on the number of color clocks until the current frame completes, assuming
+ * no TIA register is written in the meantime: the clock of the first queued write asserting VSYNC
+ * has to run, or else the watchdog ends the frame. The system uses this to decide how far the CPU
+ * may run ahead of the TIA.
+ */
+uint32_t TIA::clocksUntilFrameDone() const {
+    uint64_t clocks = FRAME_WATCHDOG - m_frameCounter;
+
+    if (m_frameEnd != NO_FRAME_END) {
+        clocks = std::min(clocks, m_frameEnd + 1 - m_clocks);
+    }
+
+    return static_cast<uint32_t>(clocks);
 }
 
 /**
@@ -304,93 +902,67 @@ void TIA::drawBall() {
  * sprites, and altering TIA states according to beam positioning as well as data from RAM.
  */
 void TIA::step() {
+    m_clocks++;
     m_frameCounter++;
-    if (m_frameCounter >= 208 * 262 / 2) {
-        m_frameDone = true;
-        m_frameCounter = 0;
-    }
-
-    if ((m_atari->read8(VSYNC) & 0x02) && m_state != TIA_VSYNC) {
-        m_beamX = 0;
-        m_beamY = 0;
-        m_state = TIA_VSYNC;
-    }
-
-    if (m_atari->m_wsync) {
-        m_atari->m_wsync = 0;
-        if (40 <= m_beamY && m_beamY <= 231) {
-            drawPlayfield();
-            drawPlayer0();
-            drawPlayer1();
-            drawMissile0();
-            drawMissile1();
-            drawBall();
-        }
+    if (m_frameCounter >= FRAME_WATCHDOG) {
+        endFrame(true);
+    }
 
-        m_beamY++;
-        m_beamX = 0;
-
-        if (m_beamY >= 262) {
-            m_beamY = 0;
-            m_state = TIA_VSYNC;
-        } else if (m_beamY >= 232) {
-            m_state = TIA_OVERSCAN;
-        } else if (m_beamY >= 40) {
-            m_state = TIA_HBLANK;
-        } else if (m_beamY >= 3) {
-            m_state = TIA_VBLANK;
-        } else {
-            m_state = TIA_VSYNC;
-        }
-    } else if (m_atari->m_resp0) {
-        m_atari->m_resp0 = 0;
+    if (m_resp0) {
+        m_resp0 = 0;
+        m_stale |= STALE_P0;
         if (m_beamX <= 68) {
             m_p0x = 3;
         } else {
             m_p0x = m_beamX - 68;
         }
-    } else if (m_atari->m_resp1) {
-        m_atari->m_resp1 = 0;
+    } else if (m_resp1) {
+        m_resp1 = 0;
+        m_stale |= STALE_P1;
         if (m_beamX <= 68) {
             m_p1x = 3;
         } else {
             m_p1x = m_beamX - 68;
         }
-    } else if (m_atari->m_resm0) {
-        m_atari->m_resm0 = 0;
+    } else if (m_resm0) {
+        m_resm0 = 0;
+        m_stale |= STALE_M0;
         if (m_beamX <= 68) {
             m_m0x = 2;
         } else {
             m_m0x = m_beamX - 68;
         }
-    } else if (m_atari->m_resm1) {
-        m_atari->m_resm1 = 0;
+    } else if (m_resm1) {
+        m_resm1 = 0;
+        m_stale |= STALE_M1;
         if (m_beamX <= 68) {
             m_m1x = 2;
         } else {
             m_m1x = m_beamX - 68;
         }
-    } else if (m_atari->m_resbl) {
-        m_atari->m_resbl = 0;
+    } else if (m_resbl) {
+        m_resbl = 0;
+        m_stale |= STALE_BL;
         if (m_beamX <= 68) {
             m_blx = 2;
         } else {
             m_blx = m_beamX - 68;
         }
-    } else if (m_atari->m_hmove) {
-        m_atari->m_hmove = 0;
-        m_p0x = (((int16_t) m_p0x - toSigned(m_atari->read8(HMP0))) + WIDTH) % WIDTH;
-        m_p1x = (((int16_t) m_p1x - toSigned(m_atari->read8(HMP1))) + WIDTH) % WIDTH;
-        m_m0x = (((int16_t) m_m0x - toSigned(m_atari->read8(HMM0))) + WIDTH) % WIDTH;
-        m_m1x = (((int16_t) m_m1x - toSigned(m_atari->read8(HMM1))) + WIDTH) % WIDTH;
-        m_blx = (((int16_t) m_blx - toSigned(m_atari->read8(HMBL))) + WIDTH) % WIDTH;
-    } else if (m_atari->m_hmclr) {
-        m_atari->m_hmclr = 0;
-        m_atari->write8(HMP0, 0x00);
-        m_atari->write8(HMP1, 0x00);
-        m_atari->write8(HMM0, 0x00);
-        m_atari->write8(HMM1, 0x00);
-        m_atari->write8(HMBL, 0x00);
+    } else if (m_hmove) {
+        m_hmove = 0;
+        m_stale |= STALE_P0 | STALE_P1 | STALE_M0 | STALE_M1 | STALE_BL;
+        m_p0x = (((int16_t) m_p0x - toSigned(m_regs[HMP0])) + WIDTH) % WIDTH;
+        m_p1x = (((int16_t) m_p1x - toSigned(m_regs[HMP1])) + WIDTH) % WIDTH;
+        m_m0x = (((int16_t) m_m0x - toSigned(m_regs[HMM0])) + WIDTH) % WIDTH;
+        m_m1x = (((int16_t) m_m1x - toSigned(m_regs[HMM1])) + WIDTH) % WIDTH;
+        m_blx = (((int16_t) m_blx - toSigned(m_regs[HMBL])) + WIDTH) % WIDTH;
+    } else if (m_hmclr) {
+        m_hmclr = 0;
+        m_regs[HMP0] = 0x00;
+        m_regs[HMP1] = 0x00;
+        m_regs[HMM0] = 0x00;
+        m_regs[HMM1] = 0x00;
+        m_regs[HMBL] = 0x00;
     }
 
     m_beamX++;
@@ -400,6 +972,7 @@ void TIA::step() {
             if (m_beamX >= 228) {
                 m_beamX = 0;
                 m_beamY++;
+                m_frameLines++;
 
                 if (m_beamY >= 3) {
                     m_state = TIA_VBLANK;
@@ -411,6 +984,7 @@ void TIA::step() {
             if (m_beamX >= 228) {
                 m_beamX = 0;
                 m_beamY++;
+                m_frameLines++;
 
                 if (m_beamY >= 40) {
                     m_state = TIA_HBLANK;
@@ -425,9 +999,13 @@ void TIA::step() {
             break;
 
         case TIA_DRAW:
+            // The pixel the beam has just passed
+            drawSpan(m_beamX - 69, m_beamX - 68);
+
             if (m_beamX >= 228) {
                 m_beamX = 0;
                 m_beamY++;
+                m_frameLines++;
 
                 if (m_beamY >= 232) {
                     m_state = TIA_OVERSCAN;
@@ -436,25 +1014,13 @@ void TIA::step() {
                     m_state = TIA_HBLANK;
                 }
             }
-
-            drawPlayfield();
-            drawPlayer0();
-            drawPlayer1();
-            drawMissile0();
-            drawMissile1();
-            drawBall();
             break;
 
         case TIA_OVERSCAN:
             if (m_beamX >= 228) {
                 m_beamX = 0;
                 m_beamY++;
-
-                if (m_beamY >= 262) {
-                    m_beamY = 0;
-                    m_state = TIA_VSYNC;
-                    m_frameDone = true;
-                }
+                m_frameLines++;
             }
             break;
     }
@@ -2,34 +2,146 @@
 
 #include <array>
 #include <cstdint>
+#include <vector>
 
-#include "olcPixelGameEngine.h"
+#include "Audio.hpp"
+#include "LineMask.hpp"
+#include "VideoSink.hpp"
 
-#define WIDTH 160
 #define HEIGHT 192
 
+// Color clocks after which a frame is considered complete if VSYNC hasn't been asserted (the
+// beam passing 320 lines, as many as the longest frames games produce)
+#define FRAME_WATCHDOG (320 * 228)
+
+// Register writes a snapshot of the TIA can hold which are still queued once it has caught up
+// with the CPU, i.e. those of the CPU's current cycle
+#define STATE_EVENTS 8
+
 class Atari;
 
 class TIA {
 public:
+    /**
+     * Timing of the frames the game produces, for the frontend to show.
+     */
+    struct FrameStats {
+        // Frames completed, and of those, the ones the watchdog ended
+        uint64_t frames = 0;
+        uint64_t watchdogFrames = 0;
+
+        // Scanlines of the last frame, the change from the frame before, and the range seen
+        uint32_t scanlines = 0;
+        int32_t jitter = 0;
+        uint32_t minScanlines = UINT32_MAX;
+        uint32_t maxScanlines = 0;
+    };
+
+    /**
+     * A write to a register by the CPU, to be applied before the TIA runs the given color clock.
+     */
+    struct Event {
+        uint64_t clock;
+        uint8_t reg;
+        uint8_t value;
+    };
+
+    /**
+     * Everything the picture depends on from here on, as a plain struct to snapshot (see
+     * Atari::State). The frame drawn so far and the frame statistics are left out.
+     */
+    struct State {
+        uint64_t clocks;
+        uint64_t frameEnd;
+        uint32_t frameCounter;
+        uint32_t frameLines;
+        uint16_t beamY;
+        uint8_t beamX;
+        uint8_t state;
+        uint8_t frameDone;
+        uint8_t vsyncQueued;
+        std::array<uint8_t, 0x40> regs;
+
+        // Positions of P0, P1, M0, M1 and BL, and the strobes pending in register order (RESP0 to
+        // RESBL, HMOVE, HMCLR)
+        std::array<uint8_t, 5> positions;
+        std::array<uint8_t, 7> strobes;
+
+        uint8_t eventCount;
+        std::array<Event, STATE_EVENTS> events;
+
+        Audio::State audio;
+    };
+
     TIA();
     ~TIA();
 
     void connectAtari(Atari* atari);
+    void connectVideo(VideoSink* video);
     void reset();
-    olc::Sprite& getScreen();
+    bool save(State& state) const;
+    void load(const State& state);
+    const uint8_t* getFrame() const;
+    static void expand(const uint8_t* frame, uint32_t* pixels);
+    void write(uint64_t clock, uint8_t reg, uint8_t value);
     void step();
+    uint32_t run(uint32_t clocks);
+    uint32_t clocksUntilFrameDone() const;
+    uint32_t clocksUntilLineEnd() const;
 
     bool m_frameDone = false;
+    FrameStats m_frameStats;
+
+    // Sound generators, caught up whenever a sound register is written and when a frame completes
+    Audio m_audio;
+
+    // Color clocks run since power on
+    uint64_t m_clocks = 0;
+
+    // Registers, indexed by their address; written ones hold the last value applied
+    std::array<uint8_t, 0x40> m_regs = {};
 
 private:
-    inline olc::Pixel& getColor(uint8_t color);
-    void drawPlayfield();
-    void drawPlayer0();
-    void drawPlayer1();
-    void drawMissile0();
-    void drawMissile1();
-    void drawBall();
+    typedef void (TIA::*RegisterWrite)(uint8_t reg, uint8_t value);
+
+    static constexpr uint64_t NO_FRAME_END = UINT64_MAX;
+
+    // Writes applied which are kept at the front of the queue at most
+    static constexpr size_t APPLIED_EVENTS = 64;
+
+    // Masks of the line drawSpan() has to work out again, the objects' registers or positions
+    // having changed since
+    static constexpr uint8_t STALE_PF = 0x01;
+    static constexpr uint8_t STALE_P0 = 0x02;
+    static constexpr uint8_t STALE_P1 = 0x04;
+    static constexpr uint8_t STALE_M0 = 0x08;
+    static constexpr uint8_t STALE_M1 = 0x10;
+    static constexpr uint8_t STALE_BL = 0x20;
+    static constexpr uint8_t STALE_ALL = 0x3F;
+
+    void applyEvents();
+    uint32_t clocksUntilChange() const;
+    void advance(uint32_t clocks);
+    void store(uint8_t reg, uint8_t value);
+    void ignore(uint8_t reg, uint8_t value);
+    void writeVsync(uint8_t reg, uint8_t value);
+    void writeAudio(uint8_t reg, uint8_t value);
+    void endFrame(bool watchdog);
+    uint64_t nextFrameEnd() const;
+    template <uint8_t TIA::*Strobe> void strobe(uint8_t reg, uint8_t value);
+    void clearCollisions(uint8_t reg, uint8_t value);
+    static constexpr std::array<RegisterWrite, 0x40> registerWrites();
+    static constexpr std::array<uint8_t, 0x40> registerMasks();
+
+    // Handlers applying the writes to each register, and the masks each write makes stale
+    static const std::array<RegisterWrite, 0x40> s_writes;
+    static const std::array<uint8_t, 0x40> s_masks;
+
+    void drawSpan(uint8_t from, uint8_t to);
+    void updateMasks();
+    LineMask playfield(uint8_t ctrlpf) const;
+    void latchCollisions(const LineMask& pf, const LineMask& p0, const LineMask& p1,
+        const LineMask& m0, const LineMask& m1, const LineMask& bl);
 
     enum {
         TIA_VSYNC,
@@ -41,7 +153,13 @@ private:
 
     uint8_t m_beamX = 0;
     uint16_t m_beamY = 0;
+
+    // Color clocks and scanlines since the last frame was completed
     uint32_t m_frameCounter = 0;
+    uint32_t m_frameLines = 0;
+
+    // Whether the frame in progress started with a reset or a load rather than with VSYNC
+    bool m_partialFrame = true;
 
     uint8_t m_p0x = 0;
     uint8_t m_p1x = 0;
@@ -49,9 +167,42 @@ private:
     uint8_t m_m1x = 0;
     uint8_t m_blx = 0;
 
+    // Strobe registers written but not acted upon yet
+    uint8_t m_resp0 = 0;
+    uint8_t m_resp1 = 0;
+    uint8_t m_resm0 = 0;
+    uint8_t m_resm1 = 0;
+    uint8_t m_resbl = 0;
+    uint8_t m_hmove = 0;
+    uint8_t m_hmclr = 0;
+
+    // Pixels of a line each object covers and the playfield expanded into colors, kept from one
+    // span to the next until something they depend on changes (see m_stale)
+    LineMask m_pfMask;
+    LineMask m_p0Mask;
+    LineMask m_p1Mask;
+    LineMask m_m0Mask;
+    LineMask m_m1Mask;
+    LineMask m_blMask;
+    std::array<uint8_t, WIDTH> m_pfRow = {};
+    uint8_t m_pfRowColors[3] = {};
+    uint8_t m_stale = STALE_ALL;
+
+    // Register writes queued up in order of their clock, the first m_nextEvent already applied
+    std::vector<Event> m_events;
+    size_t m_nextEvent = 0;
+
+    // VSYNC as the last write queued leaves it, and the clock of the first queued write asserting
+    // it (which completes the frame), NO_FRAME_END if none
+    uint8_t m_vsyncQueued = 0;
+    uint64_t m_frameEnd = NO_FRAME_END;
+
     Atari* m_atari;
 
-    olc::Sprite m_sprScreen = olc::Sprite(WIDTH, HEIGHT);
-    std::array<std::array<olc::Pixel, 16>, 8> m_colorRom;
+    // Where completed frames go, if anywhere
+    VideoSink* m_video = nullptr;
+
+    // The screen as palette indices, expanded into colors by whoever it's presented to
+    std::array<uint8_t, WIDTH * HEIGHT> m_frame = {};
 };
 
@@ -16,68 +16,72 @@
  *                   $$$$$Y'          $$$$$          `Y$$$$$
  *
  * Timer.cpp: class which encapsulates the Atari 2600's PIA timer.
+ *
+ * Rather than being counted down cycle by cycle, the timer only remembers when it was last
+ * written. INTIM and INSTAT are worked out in closed form from the number of cycles since then
+ * whenever the CPU reads them, so cycles in which the timer isn't read cost nothing.
  */
-#include "Atari.hpp"
 #include "Timer.hpp"
 
 Timer::Timer() = default;
 Timer::~Timer() = default;
 
-void Timer::connectAtari(Atari* atari) {
-    m_atari = atari;
+void Timer::save(State& state) const {
+    state.start = m_start;
+    state.value = m_value;
+    state.shift = m_shift;
+}
+
+void Timer::load(const State& state) {
+    m_start = state.start;
+    m_value = state.value;
+    m_shift = state.shift;
 }
 
 /**
- * @brief Perform one action for the PIA timer. If the interval has been changed by the CPU, update
- * it and restart the inner clock.
+ * @brief Restart the timer: write INTIM on the given CPU cycle, to be decremented every
+ * 1 << shift cycles from then on.
  */
-void Timer::step() {
-    if (m_atari->m_tim1t) {
-        m_atari->m_tim1t = 0;
-        setInterval(m_atari->read8(TIM1T), 1);
-    } else if (m_atari->m_tim8t) {
-        m_atari->m_tim8t = 0;
-        setInterval(m_atari->read8(TIM8T), 8);
-    } else if (m_atari->m_tim64t) {
-        m_atari->m_tim64t = 0;
-        setInterval(m_atari->read8(TIM64T), 64);
-    } else if (m_atari->m_t1024t) {
-        m_atari->m_t1024t = 0;
-        setInterval(m_atari->read8(T1024T), 1024);
-    }
-
-    if (--m_count == 0) {
-        pulse();
-    }
+void Timer::write(uint64_t cycle, uint8_t value, uint8_t shift) {
+    m_start = cycle;
+    m_value = value;
+    m_shift = shift;
 }
 
 /**
- * @brief Whenever the timer's inner clock has reached 0, update the CPU's INTIM memory variable.
- * If that has reached 0, then an underflow has occurred. Here, the inner clock and interval are
- * set to 1 so that the CPU can count how many cycles ago the underflow occurred.
+ * INTIM as read on the given CPU cycle. The write loads the value and the first decrement happens
+ * on the very next cycle; after that INTIM is decremented every interval. Once it has gone past
+ * 0, i.e. value * interval cycles after the write, the timer underflows to 0xFF and from then on
+ * counts down every cycle, so the CPU can tell how long ago the underflow happened.
  */
-void Timer::pulse() {
-    if (m_atari->read8(INTIM) == 0x00) {
-        // Underflow
-        m_atari->write8(INSTAT, m_atari->read8(INSTAT) | 0xC0);
-        m_atari->write8(INTIM, 0xFF);
-        m_interval = 1;
-        m_count = 1;
-    } else {
-        m_count = m_interval;
-        m_atari->write8(INTIM, m_atari->read8(INTIM) - 1);
+uint8_t Timer::readIntim(uint64_t cycle) const {
+    uint64_t elapsed = cycle - m_start;
+    uint64_t underflow = static_cast<uint64_t>(m_value) << m_shift;
+
+    if (elapsed < underflow) {
+        return m_value - 1 - (elapsed >> m_shift);
     }
+    return 0xFF - (elapsed - underflow);
 }
 
 /**
- * @brief Whenever the CPU changes its timer interval, update the timer's inner timer interval and
- * update the CPU's INTIM value to reflect this.
+ * @brief Whether the timer has underflowed since it was last written, as of the given CPU cycle
+ * (INSTAT bits 7 and 6).
  */
-void Timer::setInterval(uint8_t value, uint16_t clockInterval) {
-    m_atari->write8(INTIM, value);
-    m_atari->write8(INSTAT, m_atari->read8(INSTAT) & 0x3F);
-    m_count = clockInterval;
-    m_interval = clockInterval;
-    pulse();
+bool Timer::underflowed(uint64_t cycle) const {
+    return cycle - m_start >= static_cast<uint64_t>(m_value) << m_shift;
 }
 
+/**
+ * First CPU cycle after the given one on which INTIM reads a different value: the end of the
+ * current interval before the underflow, the very next cycle after it. A loop polling INTIM can
+ * skip ahead to there, all of its reads in between returning the same value.
+ */
+uint64_t Timer::nextChange(uint64_t cycle) const {
+    uint64_t elapsed = cycle - m_start;
+
+    if (elapsed < static_cast<uint64_t>(m_value) << m_shift) {
+        return m_start + (((elapsed >> m_shift) + 1) << m_shift);
+    }
+    return cycle + 1;
+}
@@ -1,21 +1,34 @@
 #pragma once
 
-class Atari;
+#include <cstdint>
 
 class Timer {
 public:
+    /**
+     * Everything the timer's behaviour depends on, as a plain struct to snapshot (see
+     * Atari::State).
+     */
+    struct State {
+        uint64_t start;
+        uint8_t value;
+        uint8_t shift;
+    };
+
     Timer();
     ~Timer();
 
-    void connectAtari(Atari* atari);
-    void step();
+    void save(State& state) const;
+    void load(const State& state);
 
-private:
-    void pulse();
-    void setInterval(uint8_t value, uint16_t clockInterval);
+    void write(uint64_t cycle, uint8_t value, uint8_t shift);
+    uint8_t readIntim(uint64_t cycle) const;
+    bool underflowed(uint64_t cycle) const;
+    uint64_t nextChange(uint64_t cycle) const;
 
-    Atari* m_atari;
-    uint16_t m_count = 1024;
-    uint16_t m_interval = 1024;
+private:
+    // CPU cycle the timer was last written on, the value written and its interval as a shift.
+    // Until the CPU writes it, the timer runs as if it had been written 1 with T1024T on power on.
+    uint64_t m_start = 0;
+    uint8_t m_value = 1;
+    uint8_t m_shift = 10;
 };
-
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Where the TIA hands every frame it completes (see TIA::connectVideo()), such as a window or a
+ * file. Frames are WIDTH * HEIGHT palette indices, which TIA::expand() turns into colors; they're
+ * only valid for the duration of the call, as the TIA goes on to draw the next frame over them.
+ */
+class VideoSink {
+public:
+    virtual ~VideoSink() = default;
+
+    virtual void presentFrame(const uint8_t* frame) = 0;
+};
@@ -0,0 +1,95 @@
+/*
+ *                                 $$ $$$$$ $$
+ *                                 $$ $$$$$ $$
+ *                                .$$ $$$$$ $$.
+ *                                :$$ $$$$$ $$:
+ *                                $$$ $$$$$ $$$
+ *                                $$$ $$$$$ $$$
+ *                               ,$$$ $$$$$ $$$.
+ *                              ,$$$$ $$$$$ $$$$.
+ *                             ,$$$$; $$$$$ :$$$$.
+ *                            ,$$$$$  $$$$$  $$$$$.
+ *                          ,$$$$$$'  $$$$$  `$$$$$$.
+ *                        ,$$$$$$$'   $$$$$   `$$$$$$$.
+ *                     ,s$$$$$$$'     $$$$$     `$$$$$$$s.
+ *                   $$$$$$$$$'       $$$$$       `$$$$$$$$$
+ *                   $$$$$Y'          $$$$$          `Y$$$$$
+ *
+ * WavSink.cpp: writes the emulator's sound to a WAV file (16-bit mono PCM), for listening to it
+ * or comparing it without an audio device.
+ *
+ * The header is written with empty sizes when the file is opened and filled in when it's closed,
+ * so that samples can be appended as they come.
+ */
+#include <algorithm>
+
+#include "WavSink.hpp"
+
+WavSink::WavSink() = default;
+
+WavSink::~WavSink() {
+    close();
+}
+
+/**
+ * @brief Start a new WAV file of the given sample rate, replacing any file which was open.
+ * @return true if the file could be created
+ */
+bool WavSink::open(const std::string& path, uint32_t rate) {
+    close();
+
+    m_file.open(path, std::ofstream::binary);
+    m_rate = rate;
+    m_count = 0;
+    writeHeader();
+    return static_cast<bool>(m_file);
+}
+
+/**
+ * @brief Append samples from 0 to 1, as the TIA produces them (see Audio::m_samples).
+ */
+void WavSink::write(const float* samples, size_t count) {
+    if (!m_file.is_open()) {
+        return;
+    }
+
+    for (size_t i = 0; i < count; i++) {
+        int16_t sample = static_cast<int16_t>(std::min(std::max(samples[i], 0.0f), 1.0f) * 32767);
+        uint8_t bytes[2] = { static_cast<uint8_t>(sample), static_cast<uint8_t>(sample >> 8) };
+
+        m_file.write(reinterpret_cast<const char*>(bytes), sizeof(bytes));
+    }
+    m_count += count;
+}
+
+/**
+ * @brief Fill in the sizes in the header and close the file.
+ */
+void WavSink::close() {
+    if (m_file.is_open()) {
+        m_file.seekp(0);
+        writeHeader();
+        m_file.close();
+    }
+}
+
+/**
+ * @brief Write the RIFF header for the samples written so far, all fields little endian.
+ */
+void WavSink::writeHeader() {
+    uint32_t dataSize = m_count * 2;
+    uint8_t header[44] = { 'R', 'I', 'F', 'F', 0, 0, 0, 0, 'W', 'A', 'V', 'E',
+        'f', 'm', 't', ' ', 16, 0, 0, 0, 1, 0, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 2, 0, 16, 0,
+        'd', 'a', 't', 'a', 0, 0, 0, 0 };
+    const uint32_t fields[][2] = {
+        { 4, 36 + dataSize }, { 24, m_rate }, { 28, m_rate * 2 }, { 40, dataSize }
+    };
+
+    for (const auto& field : fields) {
+        for (int i = 0; i < 4; i++) {
+            header[field[0] + i] = static_cast<uint8_t>(field[1] >> (8 * i));
+        }
+    }
+
+    m_file.write(reinterpret_cast<const char*>(header), sizeof(header));
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+
+#include "AudioSink.hpp"
+
+class WavSink : public AudioSink {
+public:
+    WavSink();
+    ~WavSink();
+
+    bool open(const std::string& path, uint32_t rate);
+    void write(const float* samples, size_t count) override;
+    void close();
+
+private:
+    void writeHeader();
+
+    std::ofstream m_file;
+    uint32_t m_rate = 0;
+
+    // Samples written since the file was opened
+    uint32_t m_count = 0;
+};